@@ -4,22 +4,33 @@
  */
 #include "Phoenix.h"
 
+#include <algorithm>
 #include <clocale>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <thread>
 #include <vector>
 
+#include "build/BuiltinLanguages.h"
+#include "build/Daemon.h"
 #include "build/Generators.h"
 #include "build/LanguageInfo.h"
+#include "build/Snapshot.h"
 #include "build/Target.h"
+#include "build/generators/NinjaGenerator.h"
 
 #include "script/Interpreter.h"
 #include "script/Debugger.h"
+#include "script/MemoryProfiler.h"
+#include "script/Profiler.h"
 #include "script/Stack.h"
 
 #include "util/FSUtil.h"
 #include "util/StringUtil.h"
 #include "util/PrintUtil.h"
 #include "util/TermUtil.h"
+#include "util/TraceUtil.h"
 
 using std::vector;
 using std::string;
@@ -54,10 +65,56 @@ void printUsage(string program, bool full)
 	// cerr << "\t-X<target>\tCross-compile to <target>." << std::endl; // TODO
 	cerr << "\t-C:<lang>:<compiler>\tPreferred compiler for <lang> to use." <<
 		std::endl;
+	cerr << "\t-L<directory>\t\tDirectory to search for language definitions" <<
+		" overriding the built-in ones." << std::endl;
+	cerr << "\t--generate-language-tables=<file>\tRegenerate the built-in language" <<
+		" tables from data/languages/." << std::endl;
+	cerr << "\t--check-globs=<file>\tTouch <file> if the source directories listed" <<
+		" in it have had files added or removed (used by the build files.)" << std::endl;
+	cerr << "\t--trace=<file>\tWrite a trace of the configure process to <file>," <<
+		" in Chrome trace-event format." << std::endl;
+	cerr << "\t--profile-script[=<prefix>]\tProfile the scripts, and write the" <<
+		" results to <prefix>.txt and <prefix>.folded." << std::endl;
+	cerr << "\t--profile-memory[=<file>]\tAttribute the memory the scripts use to" <<
+		" the lines that allocated it, and write a report to <file>." << std::endl;
+	cerr << "\t--parallel-subdirectories[=<jobs>]\tEvaluate independent sibling" <<
+		" subdirectories concurrently." << std::endl;
+	cerr << "\t--split-ninja\tWrite each target's build edges to a Ninja file of its" <<
+		" own, so that changing one target rewrites just that file." << std::endl;
+	cerr << "\t--parallel-search[=<jobs>]\tList the directories of recursive source" <<
+		" searches concurrently." << std::endl;
+	cerr << "\t--no-snapshot\tRe-run the scripts even if nothing they depend on" <<
+		" has changed since the last run." << std::endl;
+	cerr << "\t--watch\tStay resident, and update the build files as soon as the" <<
+		" scripts or the files and directories they use change; running Phoenix" <<
+		" again in the build directory then just asks it to." << std::endl;
+	cerr << "\t--refresh\tAsk the Phoenix daemon in the build directory (see --watch)" <<
+		" to update the build files, or update them as usual if there is none" <<
+		" (used by the build files.)" << std::endl;
 	cerr << "\t--debugger\tLaunch into the interactive Phoenix script debugger." <<
 		std::endl;
 }
 
+// Where the listings of searched directories are kept between runs.
+static const char* kDirectoryCacheFile = "phoenix.dircache";
+
+static void writeBuildFiles(Generator* gen, const string& generator,
+	const vector<string>& secondaryGenerators, const string& rerunCommand,
+	const string& phoenix, const vector<string>& inputFiles)
+{
+	std::cout << "generating build files for " << generator;
+	for (string gen : secondaryGenerators)
+		std::cout << ", " + gen;
+	std::cout << "... ";
+	LanguageInfo::resetGenerated();
+	gen->setBuildScriptFiles(rerunCommand, inputFiles);
+	gen->setSourceGlobs(phoenix, Snapshot::globs());
+	for (Target* target : Target::targets)
+		target->generate(gen);
+	gen->write();
+	std::cout << "done" << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
 	setlocale(LC_ALL, "C"); // Force C locale
@@ -73,9 +130,11 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
-	string buildDirectory = ".", sourceDirectory, generator;
+	string buildDirectory = ".", sourceDirectory, generator, languageTablesFile, globsFile;
 	vector<string> secondaryGenerators;
-	bool debugger = false;
+	bool debugger = false, snapshots = true, watch = false, refreshOnly = false;
+	string profilePrefix, memoryProfileFile;
+	unsigned int parallelJobs = 1;
 	for (vector<string>::size_type i = 1; i < arguments.size(); i++) {
 		string arg = arguments[i];
 		if (arg == "--help") {
@@ -83,6 +142,32 @@ int main(int argc, char* argv[])
 			return 0;
 		} else if (arg == "--debugger") {
 			debugger = true;
+		} else if (arg == "--no-snapshot") {
+			snapshots = false;
+		} else if (arg == "--split-ninja") {
+			NinjaGenerator::sSplitTargets = true;
+		} else if (arg == "--watch") {
+			watch = true;
+		} else if (arg == "--refresh") {
+			refreshOnly = true;
+		} else if (arg == "--profile-script") {
+			profilePrefix = "script-profile";
+		} else if (StringUtil::startsWith(arg, "--profile-script=")) {
+			profilePrefix = arg.substr(arg.find('=') + 1);
+		} else if (arg == "--profile-memory") {
+			memoryProfileFile = "script-memory.txt";
+		} else if (StringUtil::startsWith(arg, "--profile-memory=")) {
+			memoryProfileFile = arg.substr(arg.find('=') + 1);
+		} else if (arg == "--parallel-subdirectories") {
+			parallelJobs = std::max(std::thread::hardware_concurrency(), 2u);
+		} else if (StringUtil::startsWith(arg, "--parallel-subdirectories=")) {
+			parallelJobs = std::max(std::atoi(arg.substr(arg.find('=') + 1).c_str()), 1);
+		} else if (arg == "--parallel-search") {
+			FSUtil::sSearchJobs = std::min(std::max(std::thread::hardware_concurrency(), 2u), 4u);
+		} else if (StringUtil::startsWith(arg, "--parallel-search=")) {
+			FSUtil::sSearchJobs = std::max(std::atoi(arg.substr(arg.find('=') + 1).c_str()), 1);
+		} else if (StringUtil::startsWith(arg, "--trace=")) {
+			TraceUtil::enable(arg.substr(arg.find('=') + 1));
 		} else if (StringUtil::startsWith(arg, "-C:")) {
 			vector<string> item = StringUtil::split(arg, ":");
 			if (item.size() != 3) {
@@ -90,6 +175,12 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 			LanguageInfo::sPreferredCompiler.insert({item[1], item[2]});
+		} else if (StringUtil::startsWith(arg, "-L")) {
+			LanguageInfo::sLanguageDirs.push_back(FSUtil::absolutePath(arg.substr(2)));
+		} else if (StringUtil::startsWith(arg, "--generate-language-tables=")) {
+			languageTablesFile = arg.substr(arg.find('=') + 1);
+		} else if (StringUtil::startsWith(arg, "--check-globs=")) {
+			globsFile = arg.substr(arg.find('=') + 1);
 		} else if (StringUtil::startsWith(arg, "-G")) {
 			generator = arg.substr(2);
 		} else if (StringUtil::startsWith(arg, "-S")) {
@@ -106,6 +197,16 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (!languageTablesFile.empty()) {
+		Script::Stack stack;
+		return BuiltinLanguages::generate(&stack, languageTablesFile) ? 0 : 1;
+	}
+	if (!globsFile.empty()) {
+		FSUtil::loadDirectoryCache(kDirectoryCacheFile);
+		const bool checked = Generators::checkGlobs(globsFile);
+		FSUtil::saveDirectoryCache(kDirectoryCacheFile);
+		return checked ? 0 : 1;
+	}
 	if (sourceDirectory.empty() || buildDirectory.empty()) {
 		PrintUtil::error("no source directory specified");
 		return 1;
@@ -113,49 +214,223 @@ int main(int argc, char* argv[])
 	if (generator.empty())
 		generator = Generators::defaultName();
 
+	// A daemon already keeping the build files in this directory up to date
+	// just has to be asked to do so.
+	if (watch && debugger) {
+		PrintUtil::error("--watch and --debugger cannot be used together");
+		return 1;
+	}
+	if (watch || refreshOnly) {
+		int status;
+		if (Daemon::requestRefresh(status))
+			return status;
+	}
+
 	// Directory setup
-	FSUtil::mkdir("PhoenixTemp");
+	const string probeDirectory = FSUtil::mkdtemp("phoenix");
+	if (probeDirectory.empty()) {
+		PrintUtil::error("could not create a temporary directory in '" +
+			FSUtil::tempDirectory() + "'");
+		return 1;
+	}
+	LanguageInfo::sProbeDirectory = probeDirectory;
+
+	// This must exist before the stack does, so the builtins are counted.
+	Script::MemoryProfiler* memoryProfiler = nullptr;
+	if (!memoryProfileFile.empty())
+		memoryProfiler = new Script::MemoryProfiler;
 
-	Script::Stack* stack = new Script::Stack();
-	Target::addGlobalFunction(stack);
+	const std::function<Script::Stack*()> createStack = [parallelJobs]() {
+		Script::Stack* stack = new Script::Stack();
+		Target::addGlobalFunction(stack);
+		stack->addSuperglobal("Compilers", Script::MapObject(new Script::ObjectMap()), true);
+		stack->mParallelJobs = parallelJobs;
+		return stack;
+	};
+	Script::Stack* stack = createStack();
 	LanguageInfo::sStack = stack;
-	stack->addSuperglobal("Compilers", Script::MapObject(new Script::ObjectMap()));
+	if (!profilePrefix.empty())
+		stack->mProfiler = new Script::Profiler;
 
+	// If nothing the last run's build model depended on has changed, reuse
+	// it instead of evaluating the scripts again; if only some subdirectories'
+	// inputs did, evaluate just those.
+	// (Without --watch, so that the snapshot survives switching to and from it,
+	// and so that regenerating never starts a daemon that Ninja would wait on.)
+	vector<string> commandArguments;
+	for (const string& arg : arguments) {
+		if (arg != "--watch" && arg != "--refresh")
+			commandArguments.push_back(arg);
+	}
+	const string commandLine = StringUtil::join(commandArguments, " ");
+	const string rerunCommand = commandLine + " --refresh";
+	vector<string> inputFiles;
+	string projectName;
+	Snapshot::Result snapshot = Snapshot::Stale;
+	if (snapshots)
+		FSUtil::loadDirectoryCache(kDirectoryCacheFile);
+	if (snapshots && !debugger && profilePrefix.empty() && memoryProfileFile.empty() &&
+			FSUtil::isFile(Snapshot::kFileName)) {
+		PrintUtil::checking("if the build scripts or their inputs changed");
+		snapshot = Snapshot::load(Snapshot::kFileName, commandLine, inputFiles, projectName);
+		PrintUtil::checkFinished(snapshot == Snapshot::Unchanged ? "no" :
+			snapshot == Snapshot::Changed ? "only in some subdirectories" : "yes", 2);
+	}
+
+	// Get compiler detection going while everything else is set up and the
+	// scripts are evaluated.
+	if (snapshot == Snapshot::Stale) {
+		LanguageInfo::prefetch(FSUtil::isFile(sourceDirectory) ? sourceDirectory :
+			FSUtil::combinePaths({sourceDirectory, "Phoenixfile.phnx"}));
+	}
+
+	const uint64_t configureStart = TraceUtil::now();
+	Generator* gen = nullptr;
+	int status = 0;
 	try {
-		Generator* gen = Generators::create(generator, secondaryGenerators);
+		gen = Generators::create(generator, secondaryGenerators);
 		if (gen == nullptr) {
-			FSUtil::rmdir("PhoenixTemp");
+			LanguageInfo::finishPending();
+			FSUtil::rmdir(probeDirectory, true);
 			return 1;
 		}
 		if (!gen->check()) {
-			FSUtil::rmdir("PhoenixTemp");
+			LanguageInfo::finishPending();
+			FSUtil::rmdir(probeDirectory, true);
 			return 1;
 		}
 
-		if (!debugger) {
-			Script::Run(stack, sourceDirectory);
+		if (snapshot == Snapshot::Changed && !Snapshot::reevaluate(createStack, inputFiles)) {
+			inputFiles.clear();
+			snapshot = Snapshot::Stale;
+		}
+		if (snapshot == Snapshot::Unchanged)
+			Snapshot::replay();
+		if (snapshot != Snapshot::Stale) {
+			if (!projectName.empty())
+				Generators::actual->setProjectName(projectName);
 		} else {
-			Script::Debugger(stack, sourceDirectory);
+			if (snapshots || watch)
+				Snapshot::startRecording();
+			LanguageInfo::addSuperglobals(stack);
+			if (!debugger) {
+				Script::Run(stack, sourceDirectory);
+			} else {
+				Script::Debugger(stack, sourceDirectory);
+			}
+			if (stack->mProfiler != nullptr && !stack->mProfiler->write(profilePrefix))
+				PrintUtil::warning("could not write the script profile to '" + profilePrefix + ".*'");
+			if (memoryProfiler != nullptr && !memoryProfiler->write(memoryProfileFile, stack))
+				PrintUtil::warning("could not write the memory profile to '" + memoryProfileFile + "'");
+			LanguageInfo::waitForChecks();
+			inputFiles = stack->inputFiles();
 		}
 
-		std::cout << "generating build files for " << generator;
-		for (string gen : secondaryGenerators)
-			std::cout << ", " + gen;
-		std::cout << "... ";
-		gen->setBuildScriptFiles(StringUtil::join(arguments, " "), stack->inputFiles());
-		for (Target* target : Target::targets)
-			target->generate(gen);
-		gen->write();
-		std::cout << "done" << std::endl;
+		writeBuildFiles(gen, generator, secondaryGenerators, rerunCommand, arguments[0],
+			inputFiles);
+
+		if (snapshot != Snapshot::Unchanged) {
+			if (snapshots && !Snapshot::save(Snapshot::kFileName, commandLine, inputFiles))
+				PrintUtil::warning("could not write '" + string(Snapshot::kFileName) + "'");
+			else if (!snapshots && watch)
+				Snapshot::commit(inputFiles);
+		}
 	} catch (Script::Exception e) {
 		e.print();
-		FSUtil::rmdir("PhoenixTemp");
-		return e.fType;
+		status = e.fType;
+		if (watch) {
+			// Wait for it to be fixed.
+			Snapshot::reset();
+			inputFiles = stack->inputFiles();
+		}
+	}
+	uint64_t metadataQueries, metadataStats;
+	FSUtil::metadataStatistics(metadataQueries, metadataStats);
+	TraceUtil::span("configure", "phoenix", configureStart, {
+		{"metadata queries", std::to_string(metadataQueries)},
+		{"stat calls saved", std::to_string(metadataQueries - metadataStats)}});
+
+	// Stay resident, and bring the build files up to date whenever asked to
+	// or something they depend on changes.
+	if (watch) {
+		const std::function<int(bool)> refresh = [&](bool force) {
+			const uint64_t start = TraceUtil::now();
+			FSUtil::clearMetadataCache();
+			string projectName;
+			Snapshot::Result snapshot = Snapshot::refresh(inputFiles, projectName);
+			if (snapshot == Snapshot::Unchanged && !force)
+				return 0;
+			try {
+				delete gen;
+				gen = Generators::create(generator, secondaryGenerators);
+				if (gen == nullptr || !gen->check())
+					return 1;
+
+				if (snapshot == Snapshot::Changed && !Snapshot::reevaluate(createStack, inputFiles))
+					snapshot = Snapshot::Stale;
+				if (snapshot == Snapshot::Unchanged)
+					Snapshot::replay();
+				if (snapshot != Snapshot::Stale) {
+					if (!projectName.empty())
+						Generators::actual->setProjectName(projectName);
+				} else {
+					// Start over, but with the compilers that were already detected.
+					Snapshot::reset();
+					delete stack->mProfiler;
+					delete stack;
+					stack = createStack();
+					LanguageInfo::sStack = stack;
+					LanguageInfo::addSuperglobals(stack);
+					Snapshot::startRecording();
+					Script::Run(stack, sourceDirectory);
+					LanguageInfo::waitForChecks();
+					inputFiles = stack->inputFiles();
+				}
+
+				writeBuildFiles(gen, generator, secondaryGenerators, rerunCommand, arguments[0],
+					inputFiles);
+
+				if (snapshots && !Snapshot::save(Snapshot::kFileName, commandLine, inputFiles))
+					PrintUtil::warning("could not write '" + string(Snapshot::kFileName) + "'");
+				else if (!snapshots)
+					Snapshot::commit(inputFiles);
+			} catch (Script::Exception e) {
+				e.print();
+				Snapshot::reset();
+				inputFiles = stack->inputFiles();
+				return (int)e.fType;
+			}
+			TraceUtil::span("refresh", "phoenix", start);
+			return 0;
+		};
+		Daemon daemon;
+		if (daemon.listen()) {
+			std::cout << "watching for changes (press Ctrl+C to stop)" << std::endl;
+			for (;;) {
+				vector<string> files = inputFiles, directories;
+				Snapshot::dependencies(files, directories);
+				daemon.watch(files, directories);
+				const Daemon::Event event = daemon.wait();
+				if (event == Daemon::Stopped)
+					break;
+				status = refresh(event == Daemon::Requested);
+				daemon.reply(status);
+			}
+		} else {
+			status = 1;
+		}
 	}
 
 	// Deinitialization
-	FSUtil::rmdir("PhoenixTemp");
+	if (snapshots && !FSUtil::saveDirectoryCache(kDirectoryCacheFile))
+		PrintUtil::warning("could not write '" + string(kDirectoryCacheFile) + "'");
+	delete gen;
+	LanguageInfo::finishPending();
+	FSUtil::rmdir(probeDirectory, true);
+	TraceUtil::write();
+	delete stack->mProfiler;
 	delete stack;
+	delete memoryProfiler;
 
-	return 0;
+	return status;
 }
@@ -0,0 +1,188 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "BuiltinLanguages.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "script/Interpreter.h"
+#include "script/Stack.h"
+#include "util/FSUtil.h"
+#include "util/PrintUtil.h"
+
+using std::string;
+using std::vector;
+using Script::Object;
+using Script::Type;
+
+static Object BuiltinValue_toObject(const BuiltinValue& value);
+
+static Script::ObjectMap* BuiltinValue_toMap(const BuiltinValue* children)
+{
+	Script::ObjectMap* ret = new Script::ObjectMap;
+	for (const BuiltinValue* v = children; v->kind != BuiltinValue::End; v++)
+		ret->set_ptr(v->key, BuiltinValue_toObject(*v));
+	return ret;
+}
+
+static Object BuiltinValue_toObject(const BuiltinValue& value)
+{
+	switch (value.kind) {
+	case BuiltinValue::Boolean:
+		return Script::BooleanObject(value.integer != 0);
+	case BuiltinValue::Integer:
+		return Script::IntegerObject(value.integer);
+	case BuiltinValue::String:
+		return Script::StringObject(value.string);
+	case BuiltinValue::List: {
+		Script::ObjectList* list = new Script::ObjectList;
+		for (const BuiltinValue* v = value.children; v->kind != BuiltinValue::End; v++)
+			list->push_back(BuiltinValue_toObject(*v));
+		return Script::ListObject(list);
+	}
+	case BuiltinValue::Map:
+		return Script::MapObject(BuiltinValue_toMap(value.children));
+	case BuiltinValue::End:
+		break;
+	}
+	return Script::UndefinedObject();
+}
+
+vector<string> BuiltinLanguages::list()
+{
+	vector<string> ret;
+	for (const Language* lang = sLanguages; lang->name != nullptr; lang++)
+		ret.push_back(lang->name);
+	return ret;
+}
+
+Object BuiltinLanguages::get(const string& langName)
+{
+	for (const Language* lang = sLanguages; lang->name != nullptr; lang++) {
+		if (langName == lang->name)
+			return Script::MapObject(BuiltinValue_toMap(lang->map));
+	}
+	return nullptr;
+}
+
+// Generator
+
+static string BuiltinLanguages_escape(const string& str)
+{
+	string ret = "\"";
+	for (string::size_type i = 0; i < str.size(); i++) {
+		const unsigned char c = str[i];
+		switch (c) {
+		case '\\': ret += "\\\\"; break;
+		case '"': ret += "\\\""; break;
+		case '\n': ret += "\\n"; break;
+		case '\r': ret += "\\r"; break;
+		case '\t': ret += "\\t"; break;
+		default:
+			if (c < 0x20 || c >= 0x7f) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\%03o", c);
+				ret += buf;
+			} else
+				ret += c;
+		break;
+		}
+	}
+	return ret + "\"";
+}
+
+// Emits the arrays for the children of `obj` (post-order, so that everything
+// is declared before it is referenced) and returns the name of its array.
+static string BuiltinLanguages_emit(string& out, int& counter, const Object obj)
+{
+	vector<std::pair<string, Object>> members;
+	if (obj->type() == Type::Map) {
+		for (Script::ObjectMap::const_iterator it = obj->map->begin(); it != obj->map->end(); it++)
+			members.push_back({BuiltinLanguages_escape(it->first), it->second});
+	} else {
+		for (Script::ObjectList::const_iterator it = obj->list->begin(); it != obj->list->end(); it++)
+			members.push_back({"nullptr", *it});
+	}
+
+	vector<string> entries;
+	for (const std::pair<string, Object>& member : members) {
+		const Object value = member.second;
+		string entry = "{BuiltinValue::";
+		switch (value->type()) {
+		case Type::Boolean:
+			entry += "Boolean, " + member.first + ", nullptr, " +
+				(value->boolean ? "1" : "0") + ", nullptr}";
+		break;
+		case Type::Integer:
+			entry += "Integer, " + member.first + ", nullptr, " +
+				std::to_string(value->integer) + ", nullptr}";
+		break;
+		case Type::String:
+			entry += "String, " + member.first + ", " +
+				BuiltinLanguages_escape(value->string) + ", 0, nullptr}";
+		break;
+		case Type::List:
+		case Type::Map:
+			entry += (value->type() == Type::List ? "List, " : "Map, ") + member.first +
+				", nullptr, 0, " + BuiltinLanguages_emit(out, counter, value) + "}";
+		break;
+		default:
+			throw Script::Exception(Script::Exception::TypeError,
+				"values of type '" + value->typeName() + "' cannot be built into Phoenix");
+		}
+		entries.push_back(entry);
+	}
+
+	const string name = "v" + std::to_string(counter++);
+	out += "constexpr BuiltinValue " + name + "[] = {\n";
+	for (const string& entry : entries)
+		out += "\t" + entry + ",\n";
+	out += "\t{BuiltinValue::End, nullptr, nullptr, 0, nullptr}\n};\n";
+	return name;
+}
+
+bool BuiltinLanguages::generate(Script::Stack* stack, const string& outFile)
+{
+	const string dataDir = FSUtil::combinePaths({FSUtil::parentDirectory(__FILE__),
+		"../../data/languages"});
+	vector<string> files = FSUtil::searchForFiles(dataDir, {".phnx"}, false);
+	std::sort(files.begin(), files.end());
+	if (files.empty()) {
+		PrintUtil::error("no language files found in '" + dataDir + "'");
+		return false;
+	}
+
+	string tables, languages;
+	int counter = 0;
+	try {
+		for (const string& file : files) {
+			string langName = file.substr(file.find_last_of('/') + 1);
+			langName.erase(langName.length() - 5 /* ".phnx" */);
+
+			Object info = Script::Run(stack, file);
+			Script::CoerceOrThrow("language information", info, Type::Map);
+			tables += "\n// " + langName + "\n";
+			languages += "\t{" + BuiltinLanguages_escape(langName) + ", " +
+				BuiltinLanguages_emit(tables, counter, info) + "},\n";
+		}
+	} catch (Script::Exception& e) {
+		e.print();
+		return false;
+	}
+
+	return FSUtil::setContentsIfChanged(outFile,
+		"/*\n"
+		" * (C) 2015-2017 Augustin Cavalier\n"
+		" * All rights reserved. Distributed under the terms of the MIT license.\n"
+		" */\n"
+		"// This file was automatically generated from data/languages/ by\n"
+		"// 'phoenix --generate-language-tables=<file>'. DO NOT EDIT!\n"
+		"#include \"BuiltinLanguages.h\"\n"
+		+ tables + "\n"
+		"const BuiltinLanguages::Language BuiltinLanguages::sLanguages[] = {\n" +
+		languages +
+		"\t{nullptr, nullptr}\n"
+		"};\n");
+}
@@ -0,0 +1,53 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "script/Object.h"
+
+// Predefinitions
+namespace Script { class Stack; }
+
+/*! A constant-initialized representation of a script object tree. Arrays of
+ * these are terminated by an entry with kind `End`. */
+struct BuiltinValue {
+	enum Kind {
+		End = 0,
+		Boolean,
+		Integer,
+		String,
+		List,
+		Map,
+	};
+
+	Kind kind;
+	const char* key; // only set for members of a Map
+	const char* string;
+	int32_t integer; // also holds Boolean values
+	const BuiltinValue* children;
+};
+
+class BuiltinLanguages
+{
+public:
+	static std::vector<std::string> list();
+	// Returns nullptr if there is no built-in language with this name.
+	static Script::Object get(const std::string& langName);
+
+	/*! Runs all the language files in `data/languages` through the interpreter
+	 * and writes the resulting tables out as C++ source to `outFile`. */
+	static bool generate(Script::Stack* stack, const std::string& outFile);
+
+private:
+	struct Language {
+		const char* name;
+		const BuiltinValue* map;
+	};
+	// Defined in the generated BuiltinLanguagesData.cpp.
+	static const Language sLanguages[];
+};
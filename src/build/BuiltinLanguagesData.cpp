@@ -0,0 +1,336 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+// This file was automatically generated from data/languages/ by
+// 'phoenix --generate-language-tables=<file>'. DO NOT EDIT!
+#include "BuiltinLanguages.h"
+
+// C++
+constexpr BuiltinValue v0[] = {
+	{BuiltinValue::String, nullptr, "clang", 0, nullptr},
+	{BuiltinValue::String, nullptr, "version", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v1[] = {
+	{BuiltinValue::String, "arguments", "--version", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v0},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v2[] = {
+	{BuiltinValue::String, "binary", "clang++", 0, nullptr},
+	{BuiltinValue::String, "compile", "-c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "", 0, nullptr},
+	{BuiltinValue::String, "definition", "-D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "-MD -MF ", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Makefile", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v1},
+	{BuiltinValue::String, "include", "-I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "-o ", 0, nullptr},
+	{BuiltinValue::String, "output", "-o ", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".o", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v3[] = {
+	{BuiltinValue::String, nullptr, "g++", 0, nullptr},
+	{BuiltinValue::String, nullptr, "Free Software Foundation", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v4[] = {
+	{BuiltinValue::String, "arguments", "--version", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v3},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v5[] = {
+	{BuiltinValue::String, "binary", "g++", 0, nullptr},
+	{BuiltinValue::String, "compile", "-c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "", 0, nullptr},
+	{BuiltinValue::String, "definition", "-D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "-MD -MF ", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Makefile", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v4},
+	{BuiltinValue::String, "include", "-I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "-o ", 0, nullptr},
+	{BuiltinValue::String, "output", "-o ", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".o", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v6[] = {
+	{BuiltinValue::String, nullptr, "Microsoft (R) C/C++ Optimizing Compiler", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v7[] = {
+	{BuiltinValue::String, "arguments", "", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v6},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v8[] = {
+	{BuiltinValue::String, "binary", "cl", 0, nullptr},
+	{BuiltinValue::String, "compile", "/c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "/nologo /TP /GR /EHsc", 0, nullptr},
+	{BuiltinValue::String, "definition", "/D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "/showIncludes", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Stdout", 0, nullptr},
+	{BuiltinValue::String, "dependenciesPrefix", "Note: including file:", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v7},
+	{BuiltinValue::String, "include", "/I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "/Fe", 0, nullptr},
+	{BuiltinValue::String, "output", "/Fo", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".obj", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v9[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v2},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v5},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v8},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v10[] = {
+	{BuiltinValue::String, nullptr, ".h", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".hxx", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".hpp", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".h++", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v11[] = {
+	{BuiltinValue::String, nullptr, ".cpp", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".cxx", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".c++", 0, nullptr},
+	{BuiltinValue::String, nullptr, ".cc", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v12[] = {
+	{BuiltinValue::String, "normal", "-std=gnu++0x", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c++0x", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v13[] = {
+	{BuiltinValue::String, "normal", "-std=gnu++0x", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c++0x", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v14[] = {
+	{BuiltinValue::String, "normal", "", 0, nullptr},
+	{BuiltinValue::String, "strict", "", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v15[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v12},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v13},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v14},
+	{BuiltinValue::String, "test", "#include<vector>\nint main(){std::vector<int>v={1,2,3,4};for(int i:v)i++;return 0;}", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v16[] = {
+	{BuiltinValue::String, "normal", "-std=gnu++98", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c++98", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v17[] = {
+	{BuiltinValue::String, "normal", "-std=gnu++98", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c++98", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v18[] = {
+	{BuiltinValue::String, "normal", "", 0, nullptr},
+	{BuiltinValue::String, "strict", "", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v19[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v16},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v17},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v18},
+	{BuiltinValue::String, "test", "int main(){\n#if __cplusplus != 199711L\n#error Not Cpp98\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v20[] = {
+	{BuiltinValue::Map, "11", nullptr, 0, v15},
+	{BuiltinValue::Map, "98", nullptr, 0, v19},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v21[] = {
+	{BuiltinValue::String, "compilerEnviron", "CXX", 0, nullptr},
+	{BuiltinValue::Map, "compilers", nullptr, 0, v9},
+	{BuiltinValue::List, "extraExtensions", nullptr, 0, v10},
+	{BuiltinValue::List, "sourceExtensions", nullptr, 0, v11},
+	{BuiltinValue::Map, "standardsModes", nullptr, 0, v20},
+	{BuiltinValue::String, "test", "int main(){\n#ifndef __cplusplus\n#error Not Cpp\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::String, "type", "CompiledToMachineCode", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+
+// C
+constexpr BuiltinValue v22[] = {
+	{BuiltinValue::String, nullptr, "clang", 0, nullptr},
+	{BuiltinValue::String, nullptr, "version", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v23[] = {
+	{BuiltinValue::String, "arguments", "--version", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v22},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v24[] = {
+	{BuiltinValue::String, "binary", "clang", 0, nullptr},
+	{BuiltinValue::String, "compile", "-c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "", 0, nullptr},
+	{BuiltinValue::String, "definition", "-D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "-MD -MF ", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Makefile", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v23},
+	{BuiltinValue::String, "include", "-I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "-o ", 0, nullptr},
+	{BuiltinValue::String, "output", "-o ", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".o", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v25[] = {
+	{BuiltinValue::String, nullptr, "gcc", 0, nullptr},
+	{BuiltinValue::String, nullptr, "Free Software Foundation", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v26[] = {
+	{BuiltinValue::String, "arguments", "--version", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v25},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v27[] = {
+	{BuiltinValue::String, "binary", "gcc", 0, nullptr},
+	{BuiltinValue::String, "compile", "-c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "", 0, nullptr},
+	{BuiltinValue::String, "definition", "-D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "-MD -MF ", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Makefile", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v26},
+	{BuiltinValue::String, "include", "-I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "-o ", 0, nullptr},
+	{BuiltinValue::String, "output", "-o ", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".o", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v28[] = {
+	{BuiltinValue::String, nullptr, "Microsoft (R) C/C++ Optimizing Compiler", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v29[] = {
+	{BuiltinValue::String, "arguments", "", 0, nullptr},
+	{BuiltinValue::List, "contains", nullptr, 0, v28},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v30[] = {
+	{BuiltinValue::String, "binary", "cl", 0, nullptr},
+	{BuiltinValue::String, "compile", "/c ", 0, nullptr},
+	{BuiltinValue::String, "defaultFlags", "/nologo /TC", 0, nullptr},
+	{BuiltinValue::String, "definition", "/D", 0, nullptr},
+	{BuiltinValue::String, "dependencies", "/showIncludes", 0, nullptr},
+	{BuiltinValue::String, "dependenciesFormat", "Stdout", 0, nullptr},
+	{BuiltinValue::String, "dependenciesPrefix", "Note: including file:", 0, nullptr},
+	{BuiltinValue::Map, "detect", nullptr, 0, v29},
+	{BuiltinValue::String, "include", "/I", 0, nullptr},
+	{BuiltinValue::String, "linkBinary", "/Fe", 0, nullptr},
+	{BuiltinValue::String, "output", "/Fo", 0, nullptr},
+	{BuiltinValue::String, "outputExtension", ".obj", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v31[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v24},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v27},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v30},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v32[] = {
+	{BuiltinValue::String, nullptr, ".h", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v33[] = {
+	{BuiltinValue::String, nullptr, ".c", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v34[] = {
+	{BuiltinValue::String, "normal", "-std=gnu11", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c11", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v35[] = {
+	{BuiltinValue::String, "normal", "-std=gnu11", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c11", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v36[] = {
+	{BuiltinValue::String, "normal", "", 0, nullptr},
+	{BuiltinValue::String, "strict", "", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v37[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v34},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v35},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v36},
+	{BuiltinValue::String, "test", "int main(){\n#if __STDC_VERSION__ != 201112L\n#error Not C11\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v38[] = {
+	{BuiltinValue::String, "normal", "-std=gnu89", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c89", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v39[] = {
+	{BuiltinValue::String, "normal", "-std=gnu89", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c89", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v40[] = {
+	{BuiltinValue::String, "normal", "", 0, nullptr},
+	{BuiltinValue::String, "strict", "", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v41[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v38},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v39},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v40},
+	{BuiltinValue::String, "test", "int main(){\n#if __STDC_VERSION__ <= 199409L\n#error Not C89\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v42[] = {
+	{BuiltinValue::String, "normal", "-std=gnu99", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c99", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v43[] = {
+	{BuiltinValue::String, "normal", "-std=gnu99", 0, nullptr},
+	{BuiltinValue::String, "strict", "-std=c99", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v44[] = {
+	{BuiltinValue::String, "normal", "", 0, nullptr},
+	{BuiltinValue::String, "strict", "", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v45[] = {
+	{BuiltinValue::Map, "Clang", nullptr, 0, v42},
+	{BuiltinValue::Map, "GCC", nullptr, 0, v43},
+	{BuiltinValue::Map, "MSVC", nullptr, 0, v44},
+	{BuiltinValue::String, "test", "int main(){\n#if __STDC_VERSION__ != 199901L\n#error Not C99\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v46[] = {
+	{BuiltinValue::Map, "11", nullptr, 0, v37},
+	{BuiltinValue::Map, "89", nullptr, 0, v41},
+	{BuiltinValue::Map, "99", nullptr, 0, v45},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+constexpr BuiltinValue v47[] = {
+	{BuiltinValue::String, "compilerEnviron", "CC", 0, nullptr},
+	{BuiltinValue::Map, "compilers", nullptr, 0, v31},
+	{BuiltinValue::List, "extraExtensions", nullptr, 0, v32},
+	{BuiltinValue::List, "sourceExtensions", nullptr, 0, v33},
+	{BuiltinValue::Map, "standardsModes", nullptr, 0, v46},
+	{BuiltinValue::String, "test", "int main(){\n#ifdef __cplusplus\n#error Cpp not C\n#endif\nreturn 0;}", 0, nullptr},
+	{BuiltinValue::String, "type", "CompiledToMachineCode", 0, nullptr},
+	{BuiltinValue::End, nullptr, nullptr, 0, nullptr}
+};
+
+const BuiltinLanguages::Language BuiltinLanguages::sLanguages[] = {
+	{"C++", v21},
+	{"C", v47},
+	{nullptr, nullptr}
+};
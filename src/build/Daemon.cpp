@@ -0,0 +1,265 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "Daemon.h"
+
+#include <cstdlib>
+
+#include "util/FSUtil.h"
+#include "util/PrintUtil.h"
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  include <sys/socket.h>
+#  include <sys/types.h>
+#  include <sys/un.h>
+#  include <cerrno>
+#  include <cstring>
+#  include <poll.h>
+#  include <signal.h>
+#  include <unistd.h>
+#endif
+
+using std::string;
+using std::vector;
+
+const char* Daemon::kSocketName = "phoenix.sock";
+
+#ifdef __linux__
+
+// How long nothing must change for before a refresh starts, in milliseconds.
+static const int kSettleTime = 50;
+
+static volatile sig_atomic_t Daemon_stopping = 0;
+static void Daemon_stop(int)
+{
+	Daemon_stopping = 1;
+}
+
+static sockaddr_un Daemon_address()
+{
+	// Relative, so the build directory's path can be longer than sun_path.
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, Daemon::kSocketName, sizeof(address.sun_path) - 1);
+	return address;
+}
+
+bool Daemon::requestRefresh(int& status)
+{
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+	const sockaddr_un address = Daemon_address();
+	if (::connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	string reply;
+	char buffer[64];
+	ssize_t length;
+	while ((length = ::read(fd, buffer, sizeof(buffer))) > 0 ||
+			(length < 0 && errno == EINTR)) {
+		if (length > 0)
+			reply.append(buffer, length);
+	}
+	::close(fd);
+	if (reply.empty()) {
+		PrintUtil::error("the Phoenix daemon in this directory exited without refreshing");
+		status = 1;
+	} else
+		status = atoi(reply.c_str());
+	return true;
+}
+
+Daemon::Daemon()
+	:
+	fSocket(-1),
+	fInotify(-1)
+{
+}
+
+Daemon::~Daemon()
+{
+	reply(1);
+	if (fInotify >= 0)
+		::close(fInotify);
+	if (fSocket >= 0) {
+		::close(fSocket);
+		::unlink(kSocketName);
+	}
+}
+
+bool Daemon::listen()
+{
+	// Whoever made this is gone, or requestRefresh() would have reached it.
+	::unlink(kSocketName);
+
+	fSocket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	const sockaddr_un address = Daemon_address();
+	if (fSocket < 0 || ::bind(fSocket, (const sockaddr*)&address, sizeof(address)) != 0 ||
+			::listen(fSocket, 8) != 0) {
+		PrintUtil::error(string("could not listen on '") + kSocketName + "': " + strerror(errno));
+		return false;
+	}
+	fInotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fInotify < 0) {
+		PrintUtil::error(string("could not watch for changes: ") + strerror(errno));
+		return false;
+	}
+
+	// Stop (and clean up) on Ctrl+C, and don't die if a client goes away.
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = Daemon_stop;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+	return true;
+}
+
+void Daemon::_watch(const string& directory, const string& name)
+{
+	std::map<string, int>::const_iterator it = fDirectories.find(directory);
+	int wd;
+	if (it != fDirectories.end()) {
+		wd = it->second;
+	} else {
+		wd = ::inotify_add_watch(fInotify, directory.c_str(), IN_CLOSE_WRITE | IN_CREATE |
+			IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+		if (wd < 0)
+			return; // It'll be noticed if it appears, by whatever was watching its parent.
+		fDirectories.insert({directory, wd});
+		fWatches[wd].entries = false;
+	}
+	if (name.empty())
+		fWatches[wd].entries = true;
+	else
+		fWatches[wd].names.insert(name);
+}
+
+void Daemon::watch(const vector<string>& files, const vector<string>& directories)
+{
+	for (std::map<int, Watch>::const_iterator it = fWatches.begin(); it != fWatches.end(); it++)
+		::inotify_rm_watch(fInotify, it->first);
+	fWatches.clear();
+	fDirectories.clear();
+
+	for (const string& file : files) {
+		const string path = FSUtil::absolutePath(file);
+		_watch(FSUtil::parentDirectory(path), path.substr(path.rfind('/') + 1));
+	}
+	for (const string& directory : directories)
+		_watch(FSUtil::absolutePath(directory), "");
+}
+
+bool Daemon::_readEvents()
+{
+	bool changed = false;
+	alignas(inotify_event) char buffer[16384];
+	ssize_t length;
+	while ((length = ::read(fInotify, buffer, sizeof(buffer))) > 0) {
+		for (char* pos = buffer; pos < buffer + length; ) {
+			const inotify_event* event = (const inotify_event*)pos;
+			pos += sizeof(inotify_event) + event->len;
+
+			if ((event->mask & IN_Q_OVERFLOW) != 0) {
+				changed = true;
+				continue;
+			}
+			std::map<int, Watch>::const_iterator it = fWatches.find(event->wd);
+			if (it == fWatches.end())
+				continue;
+			const Watch& watch = it->second;
+			if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0) {
+				changed = true;
+			} else if (event->len > 0 && watch.names.count(event->name) != 0) {
+				changed = true;
+			} else if (watch.entries && (event->mask & IN_CLOSE_WRITE) == 0) {
+				// Searches only care about what's there, not what's in it.
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+Daemon::Event Daemon::wait()
+{
+	bool changed = false;
+	while (Daemon_stopping == 0) {
+		pollfd fds[2] = {{fSocket, POLLIN, 0}, {fInotify, POLLIN, 0}};
+		const int count = ::poll(fds, 2, changed ? kSettleTime : -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return Stopped;
+		}
+		if (count == 0)
+			return Changed;
+		if ((fds[1].revents & POLLIN) != 0 && _readEvents())
+			changed = true;
+		if ((fds[0].revents & POLLIN) != 0) {
+			const int client = ::accept4(fSocket, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client >= 0) {
+				fClients.push_back(client);
+				return Requested;
+			}
+		}
+	}
+	return Stopped;
+}
+
+void Daemon::reply(int status)
+{
+	const string reply = std::to_string(status) + "\n";
+	for (int client : fClients) {
+		// If it gave up waiting, there is no one to tell.
+		const ssize_t written = ::write(client, reply.c_str(), reply.length());
+		(void)written;
+		::close(client);
+	}
+	fClients.clear();
+}
+
+#else
+
+bool Daemon::requestRefresh(int&)
+{
+	return false;
+}
+
+Daemon::Daemon()
+	:
+	fSocket(-1),
+	fInotify(-1)
+{
+}
+
+Daemon::~Daemon()
+{
+}
+
+bool Daemon::listen()
+{
+	PrintUtil::error("--watch is not supported on this platform");
+	return false;
+}
+
+void Daemon::watch(const vector<string>&, const vector<string>&)
+{
+}
+
+Daemon::Event Daemon::wait()
+{
+	return Stopped;
+}
+
+void Daemon::reply(int)
+{
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/*! Keeps Phoenix resident in the build directory (`--watch`): it watches the
+ * scripts and the files and directories they depend on, and listens on a
+ * Unix socket there, which later invocations connect to instead of running
+ * the scripts themselves. Connecting is a request to bring the build files up
+ * to date; the reply is the exit status of doing so.
+ *
+ * Only supported on Linux (inotify); elsewhere, listen() fails. */
+class Daemon
+{
+public:
+	static const char* kSocketName;
+
+	/*! Asks the daemon in the current directory to bring the build files up to
+	 * date, and waits for it to. Returns false if there is none, and otherwise
+	 * puts the exit status of the refresh in `status`. */
+	static bool requestRefresh(int& status);
+
+	Daemon();
+	~Daemon();
+
+	bool listen();
+
+	// Replaces what is being watched. For directories, only entries being
+	// added or removed count as changes.
+	void watch(const std::vector<std::string>& files,
+		const std::vector<std::string>& directories);
+
+	enum Event {
+		Stopped = 0, // by a signal, or an error
+		Changed,
+		Requested,
+	};
+	/*! Blocks until something that is watched changes, or a client connects.
+	 * Changes are collected until none have happened for a little while, so
+	 * that e.g. a checkout touching many files causes only one refresh. */
+	Event wait();
+	// Answers the clients that connected since the last reply().
+	void reply(int status);
+
+private:
+	void _watch(const std::string& directory, const std::string& name);
+	bool _readEvents();
+
+	int fSocket;
+	int fInotify;
+	std::vector<int> fClients;
+
+	struct Watch {
+		std::set<std::string> names; // files in it
+		bool entries; // whether entries being added or removed count
+	};
+	std::map<int, Watch> fWatches;
+	std::map<std::string, int> fDirectories;
+};
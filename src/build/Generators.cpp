@@ -8,7 +8,12 @@
 #include "generators/NinjaGenerator.h"
 #include "generators/QtCreatorGenerator.h"
 
+#include "util/FSUtil.h"
 #include "util/PrintUtil.h"
+#include "util/StringUtil.h"
+
+#include <algorithm>
+#include <cinttypes>
 
 using std::string;
 using std::vector;
@@ -20,6 +25,9 @@ string Generator::command(const string&)
 {
 	return "";
 }
+void Generator::setSourceGlobs(const string&, const vector<Glob>&)
+{
+}
 
 class MultiGenerator : public Generator
 {
@@ -49,6 +57,11 @@ public:
 		for (Generator* gen : fSecondaries)
 			gen->setBuildScriptFiles(program, files);
 	}
+	virtual void setSourceGlobs(const string& phoenix, const vector<Glob>& globs) override {
+		fPrimary->setSourceGlobs(phoenix, globs);
+		for (Generator* gen : fSecondaries)
+			gen->setSourceGlobs(phoenix, globs);
+	}
 	virtual void addRegularRule(const string& ruleName,
 		const string& descName, const vector<string>& forExts,
 		const string& program, const string& outFileExt,
@@ -69,7 +82,7 @@ public:
 	}
 	virtual void addTarget(const string& linkRule,
 		const string& outputBinaryName,
-		const vector<string>& inputFiles,
+		const vector<Path>& inputFiles,
 		const string& targetFlags, const Target* target) override {
 		fPrimary->addTarget(linkRule, outputBinaryName, inputFiles, targetFlags, target);
 		for (Generator* gen : fSecondaries)
@@ -143,3 +156,54 @@ Generator* Generators::create(string name, vector<string> secondary)
 	actual = ret;
 	return ret;
 }
+
+// Independent of the order the entries were listed in.
+static string Generators_fingerprint(vector<string> results, vector<string> directories)
+{
+	std::sort(results.begin(), results.end());
+	std::sort(directories.begin(), directories.end());
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016" PRIx64, StringUtil::hash(
+		StringUtil::join(results, "\n") + "\n\n" + StringUtil::join(directories, "\n")));
+	return buffer;
+}
+
+bool Generators::writeGlobs(const string& file, const vector<Generator::Glob>& globs)
+{
+	// One per line: fingerprint, whether it's recursive, extensions, directory.
+	string contents;
+	for (const Generator::Glob& glob : globs) {
+		contents += Generators_fingerprint(glob.results, glob.directories) + "\t" +
+			(glob.recursive ? "r" : "-") + "\t" + StringUtil::join(glob.extensions, " ") + "\t" +
+			glob.directory + "\n";
+	}
+	return FSUtil::setContentsIfChanged(file, contents);
+}
+
+bool Generators::checkGlobs(const string& file)
+{
+	const string contents = FSUtil::getContents(file);
+	bool changed = contents.empty();
+	for (StringUtil::SplitIterator line(contents, "\n"); line.next(); ) {
+		if (line.empty())
+			continue;
+		const vector<string> fields = StringUtil::split(line.str(), "\t");
+		if (fields.size() != 4) {
+			changed = true;
+			break;
+		}
+		vector<string> extensions, directories;
+		if (!fields[2].empty())
+			extensions = StringUtil::split(fields[2], " ");
+		const vector<string> results = FSUtil::searchForFiles(fields[3], extensions,
+			fields[1] == "r", &directories);
+		if (Generators_fingerprint(results, directories) != fields[0]) {
+			changed = true;
+			break;
+		}
+	}
+	// Rewriting it as it was is what tells ninja (by its mtime) to rerun Phoenix.
+	if (changed)
+		return FSUtil::setContents(file, contents);
+	return true;
+}
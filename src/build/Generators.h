@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "util/Path.h"
+
 // GCC 4.6 doesn't support "override", so compensate for that
 #if __GNUC__ == 4 && __GNUC_MINOR__ < 7
 #  define override
@@ -35,6 +37,19 @@ public:
 	virtual void setBuildScriptFiles(const std::string& program,
 		const std::vector<std::string> files) = 0;
 
+	// A search for source files (see Target's addSourceDirectory.)
+	struct Glob {
+		std::string directory;
+		std::vector<std::string> extensions;
+		bool recursive;
+		std::vector<std::string> results;
+		std::vector<std::string> directories; // that were searched
+	};
+	/*! Generates a rule that regenerates the files when what the globs match
+	 * changes, i.e. a source file was added or removed, using `phoenix
+	 * --check-globs` (see Generators::checkGlobs.) */
+	virtual void setSourceGlobs(const std::string& phoenix, const std::vector<Glob>& globs);
+
 	// Rules
 	/*! `rule` must be a command string, and should include the following keywords:
 	 * 	 - `%INPUTFILE%`: The input file name.
@@ -51,7 +66,7 @@ public:
 
 	virtual void addTarget(const std::string& linkRule,
 		const std::string& outputBinaryName,
-		const std::vector<std::string>& inputFiles,
+		const std::vector<Path>& inputFiles,
 		const std::string& targetFlags, const Target* target) = 0;
 
 	virtual std::vector<std::string> outputFiles() = 0;
@@ -71,4 +86,11 @@ public:
 	static std::vector<std::string> list();
 	static std::vector<std::string> listSecondary();
 	static Generator* create(std::string name, std::vector<std::string> secondary);
+
+	/*! Writes `globs` to `file`, with a fingerprint of what each one matched.
+	 * checkGlobs() (`--check-globs=<file>`) searches again, and touches `file`
+	 * only if any of them now match something else; so a build rule for it
+	 * with `restat` only makes what depends on it stale when that happens. */
+	static bool writeGlobs(const std::string& file, const std::vector<Generator::Glob>& globs);
+	static bool checkGlobs(const std::string& file);
 };
@@ -6,6 +6,7 @@
 
 #include <string>
 
+#include "build/BuiltinLanguages.h"
 #include "script/Interpreter.h"
 #include "util/FSUtil.h"
 #include "util/PrintUtil.h"
@@ -18,12 +19,19 @@ using Script::Type;
 // Statics
 Script::Stack* LanguageInfo::sStack;
 std::map<string, string> LanguageInfo::sPreferredCompiler;
+std::vector<string> LanguageInfo::sLanguageDirs;
+string LanguageInfo::sProbeDirectory = ".";
 std::map<string, LanguageInfo*> LanguageInfo::sData;
+std::map<string, Object> LanguageInfo::sDefinitions;
+std::map<std::pair<string, string>, OSUtil::ExecResult> LanguageInfo::sDetectResults;
+std::map<std::pair<string, string>, OSUtil::PendingExec*> LanguageInfo::sPendingDetects;
 
 LanguageInfo::LanguageInfo(string langName, Object info)
 	: name(langName),
 	  fGenerated(false)
 {
+	fWorksCheck.exec = nullptr;
+
 	genName = name;
 	StringUtil::replaceAll(genName, "+", "P");
 	StringUtil::replaceAll(genName, "-", "D");
@@ -63,8 +71,8 @@ LanguageInfo::LanguageInfo(string langName, Object info)
 				Script::CoerceOrThrow("languageInfo.compiler", comp, Type::Map);
 				Object detect = comp->get("detect");
 				Script::CoerceOrThrow("languageInfo.compiler.detect", detect, Type::Map);
-				OSUtil::ExecResult res =
-					OSUtil::exec(binary, detect->get("arguments")->asStringRaw());
+				const OSUtil::ExecResult& res =
+					detectCompiler(compilerBin, detect->get("arguments")->asStringRaw());
 				if (res.exitcode != 0)
 					continue; // did not exit with 0 -- something wrong
 				Object contains = detect->get("contains");
@@ -95,8 +103,8 @@ LanguageInfo::LanguageInfo(string langName, Object info)
 						compilerDependencyFormat = Generator::StdoutFormat;
 
 					// Update superglobals
-					sStack->addSuperglobal(compilerName, Script::BooleanObject(true));
-					sStack->get_ptr({"$Compilers"})->map->set(name, Script::StringObject(compilerName));
+					sStack->addSuperglobal(compilerName, Script::BooleanObject(true), true);
+					sStack->getSuperglobal("Compilers")->map->set(name, Script::StringObject(compilerName));
 					return true;
 				}
 			}
@@ -105,23 +113,9 @@ LanguageInfo::LanguageInfo(string langName, Object info)
 	};
 
 	PrintUtil::checking("what " + langName + " compiler to use");
-	if (!sPreferredCompiler[langName].empty()) {
-		tryCompiler(sPreferredCompiler[langName]);
-	}
-	if (compilerName.empty() && !compilerEnviron.empty()) {
-		string env = OSUtil::getEnv(compilerEnviron);
-		if (!env.empty())
-			tryCompiler(env);
-	}
-	if (compilerName.empty()) {
-		// Preferred & environ didn't work, try everything in succession instead
-		for (Script::ObjectMap::const_iterator it =
-			 comps->map->begin(); it != comps->map->end(); it++) {
-			Object comp = it->second;
-			Script::CoerceOrThrow("languageInfo.compiler", comp, Type::Map);
-			if (tryCompiler(comp->get("binary")->asStringRaw()))
-				break;
-		}
+	for (const string& binary : candidateBinaries(langName, info)) {
+		if (tryCompiler(binary))
+			break;
 	}
 	if (compilerName.empty()) {
 		PrintUtil::checkFinished("none found", 0);
@@ -147,16 +141,34 @@ LanguageInfo::LanguageInfo(string langName, Object info)
 		standardsModes.insert({it->first, mode});
 	}
 
-	// Check that the compiler works
-	PrintUtil::checking("if the " + langName + " compiler works");
-	OSUtil::ExecResult res =
-		checkIfCompiles("test" + langName, info->get("test")->asStringRaw());
+	// Start checking that the compiler works; nothing needs the result until
+	// a standards mode is tested or the build files are generated, so we
+	// don't wait for it here.
+	fWorksCheck = startCheckIfCompiles("test" + langName, info->get("test")->asStringRaw());
+}
+
+LanguageInfo::LanguageInfo()
+	:
+	compilerDependencyFormat(Generator::NoDependencies),
+	fGenerated(false)
+{
+	fWorksCheck.exec = nullptr;
+}
+
+void LanguageInfo::checkWorks()
+{
+	if (fWorksCheck.exec == nullptr)
+		return;
+
+	PrintUtil::checking("if the " + name + " compiler works");
+	OSUtil::ExecResult res = finishCheckIfCompiles(fWorksCheck);
+	fWorksCheck.exec = nullptr;
 	if (res.exitcode == 0) {
 		PrintUtil::checkFinished("yes", 2);
 	} else {
 		PrintUtil::checkFinished("no", 0);
 		throw Script::Exception(Script::Exception::UserError,
-			string("complier for " + langName + " is broken: '" + res.output + "'"));
+			string("complier for " + name + " is broken: '" + res.output + "'"));
 	}
 }
 
@@ -168,6 +180,7 @@ bool LanguageInfo::checkStandardsMode(std::string standardsMode)
 	if (mode.status < 0)
 		return false;
 
+	checkWorks();
 	PrintUtil::checking("if the standards mode '" + name + standardsMode + "' works");
 	OSUtil::ExecResult res =
 		checkIfCompiles("test" + name + standardsMode, mode.test, mode.normalFlag);
@@ -186,6 +199,7 @@ void LanguageInfo::generate(Generator* gen)
 {
 	if (fGenerated)
 		return;
+	checkWorks();
 
 	string rule = compilerCompileFlag + "%INPUTFILE% " +
 		compilerOutputFlag + "%OUTPUTFILE% %TARGETFLAGS%";
@@ -203,15 +217,72 @@ void LanguageInfo::generate(Generator* gen)
 	fGenerated = true;
 }
 
-OSUtil::ExecResult LanguageInfo::checkIfCompiles(const string& testName,
+std::vector<string> LanguageInfo::candidateBinaries(const string& langName, Object info)
+{
+	std::vector<string> ret;
+	if (!sPreferredCompiler[langName].empty())
+		ret.push_back(sPreferredCompiler[langName]);
+	Object envir = info->get("compilerEnviron");
+	if (envir->type() != Script::Type::Undefined) {
+		string env = OSUtil::getEnv(envir->asStringRaw());
+		if (!env.empty())
+			ret.push_back(env);
+	}
+
+	// Preferred & environ didn't work, try everything in succession instead
+	Object comps = info->get("compilers");
+	Script::CoerceOrThrow("languageInfo.compilers", comps, Type::Map);
+	for (Script::ObjectMap::const_iterator it =
+		 comps->map->begin(); it != comps->map->end(); it++) {
+		Object comp = it->second;
+		Script::CoerceOrThrow("languageInfo.compiler", comp, Type::Map);
+		ret.push_back(comp->get("binary")->asStringRaw());
+	}
+	return ret;
+}
+
+const OSUtil::ExecResult& LanguageInfo::detectCompiler(const string& binary,
+	const string& arguments)
+{
+	// Every compiler definition in a language gets tested against each binary,
+	// and most of them use the same arguments, so only run each pair once.
+	const std::pair<string, string> key(binary, arguments);
+	std::map<std::pair<string, string>, OSUtil::ExecResult>::const_iterator it =
+		sDetectResults.find(key);
+	if (it != sDetectResults.end())
+		return it->second;
+
+	std::map<std::pair<string, string>, OSUtil::PendingExec*>::iterator pending =
+		sPendingDetects.find(key);
+	if (pending != sPendingDetects.end()) {
+		OSUtil::PendingExec* exec = pending->second;
+		sPendingDetects.erase(pending);
+		return sDetectResults.insert({key, OSUtil::finishExec(exec)}).first->second;
+	}
+	return sDetectResults.insert({key, OSUtil::exec(binary, arguments)}).first->second;
+}
+
+LanguageInfo::PendingCheck LanguageInfo::startCheckIfCompiles(const string& testName,
 	const string& testContents, const string& extraFlags)
 {
-	string testFileBase = "PhoenixTemp/" + testName;
+	PendingCheck ret;
+	ret.testName = testName;
+	string testFileBase = FSUtil::combinePaths({sProbeDirectory, testName});
 	FSUtil::setContents(testFileBase + sourceExtensions[0], testContents);
-	OSUtil::ExecResult res = OSUtil::exec(compilerBinary,
+	ret.exec = OSUtil::execAsync(compilerBinary,
 		extraFlags + " " + testFileBase + sourceExtensions[0] + " " +
 		compilerLinkBinaryFlag + testFileBase + APPLICATION_FILE_EXT);
+	return ret;
+}
+
+OSUtil::ExecResult LanguageInfo::finishCheckIfCompiles(const PendingCheck& check)
+{
+	const string& testName = check.testName;
+	string testFileBase = FSUtil::combinePaths({sProbeDirectory, testName});
+	OSUtil::ExecResult res = OSUtil::finishExec(check.exec);
 	FSUtil::deleteFile(testFileBase + sourceExtensions[0]);
+	// (The compiler wrote it, so what FSUtil knew about it is out of date.)
+	FSUtil::invalidateMetadata(testFileBase + APPLICATION_FILE_EXT);
 	bool outFileExisted = FSUtil::exists(testFileBase + APPLICATION_FILE_EXT);
 	FSUtil::deleteFile(testFileBase + APPLICATION_FILE_EXT);
 #ifdef _WIN32
@@ -223,15 +294,154 @@ OSUtil::ExecResult LanguageInfo::checkIfCompiles(const string& testName,
 	return res;
 }
 
+OSUtil::ExecResult LanguageInfo::checkIfCompiles(const string& testName,
+	const string& testContents, const string& extraFlags)
+{
+	return finishCheckIfCompiles(startCheckIfCompiles(testName, testContents, extraFlags));
+}
+
+Object LanguageInfo::loadDefinition(const string& langName)
+{
+	std::map<string, Object>::const_iterator it = sDefinitions.find(langName);
+	if (it != sDefinitions.end())
+		return it->second;
+
+	// User-supplied definitions take precedence over the built-in ones.
+	Object info = nullptr;
+	for (const string& dir : sLanguageDirs) {
+		const string file = FSUtil::combinePaths({dir, langName + ".phnx"});
+		if (FSUtil::isFile(file)) {
+			info = Script::Run(sStack, file);
+			break;
+		}
+	}
+	if (info == nullptr)
+		info = BuiltinLanguages::get(langName);
+	if (info != nullptr)
+		sDefinitions.insert({langName, info});
+	return info;
+}
+
+void LanguageInfo::prefetch(const string& scriptFile)
+{
+	// Look for "language: 'X'" and "languages: ['X', ...]" in the script. This
+	// is only a guess at what the script will ask for, so errors are ignored.
+	const string code = FSUtil::getContents(scriptFile);
+	std::vector<string> langs;
+	string::size_type i = 0;
+	while ((i = code.find("language", i)) != string::npos) {
+		const string::size_type lineStart = code.rfind('\n', i);
+		i += 8;
+		if (code.find('#', lineStart == string::npos ? 0 : lineStart) < i)
+			continue; // commented out
+		if (i < code.length() && code[i] == 's')
+			i++;
+		while (i < code.length() && (code[i] == ' ' || code[i] == '\t'))
+			i++;
+		if (i >= code.length() || code[i] != ':')
+			continue;
+		i = code.find_first_not_of(" \t", i + 1);
+		if (i == string::npos)
+			break;
+		const string::size_type end = (code[i] == '[') ? code.find(']', i) : i + 1;
+		while (i < end && i < code.length()) {
+			const char quote = code[i];
+			if (quote != '"' && quote != '\'') {
+				i++;
+				continue;
+			}
+			const string::size_type close = code.find(quote, i + 1);
+			if (close == string::npos)
+				break;
+			langs.push_back(code.substr(i + 1, close - i - 1));
+			i = close + 1;
+		}
+	}
+
+	for (const string& lang : langs) {
+		if (sData.count(lang) != 0)
+			continue;
+		try {
+			Object info = loadDefinition(lang);
+			if (info == nullptr || info->type() != Type::Map)
+				continue;
+			Object comps = info->get("compilers");
+			if (comps->type() != Type::Map)
+				continue;
+			for (const string& binary : candidateBinaries(lang, info)) {
+				const string compilerBin = FSUtil::which(binary);
+				if (!FSUtil::exists(compilerBin))
+					continue;
+				for (Script::ObjectMap::const_iterator it =
+					 comps->map->begin(); it != comps->map->end(); it++) {
+					if (it->second->type() != Type::Map)
+						continue;
+					Object detect = it->second->get("detect");
+					if (detect->type() != Type::Map)
+						continue;
+					const std::pair<string, string> key(compilerBin,
+						detect->get("arguments")->asStringRaw());
+					if (sDetectResults.count(key) == 0 && sPendingDetects.count(key) == 0)
+						sPendingDetects.insert({key, OSUtil::execAsync(key.first, key.second)});
+				}
+			}
+		} catch (Script::Exception&) {
+			// It'll be reported again when the language is actually used.
+		}
+	}
+}
+
+void LanguageInfo::waitForChecks()
+{
+	for (std::map<string, LanguageInfo*>::const_iterator it = sData.begin();
+		 it != sData.end(); it++)
+		it->second->checkWorks();
+}
+
+void LanguageInfo::finishPending()
+{
+	for (std::map<string, LanguageInfo*>::const_iterator it = sData.begin();
+		 it != sData.end(); it++) {
+		LanguageInfo* info = it->second;
+		if (info->fWorksCheck.exec != nullptr) {
+			info->finishCheckIfCompiles(info->fWorksCheck);
+			info->fWorksCheck.exec = nullptr;
+		}
+	}
+	for (std::map<std::pair<string, string>, OSUtil::PendingExec*>::const_iterator it =
+		 sPendingDetects.begin(); it != sPendingDetects.end(); it++)
+		OSUtil::finishExec(it->second);
+	sPendingDetects.clear();
+}
+
+void LanguageInfo::addSuperglobals(Script::Stack* stack)
+{
+	for (std::map<string, LanguageInfo*>::const_iterator it = sData.begin();
+		 it != sData.end(); it++) {
+		const LanguageInfo* info = it->second;
+		stack->addSuperglobal(info->compilerName, Script::BooleanObject(true), true);
+		stack->getSuperglobal("Compilers")->map->set(info->name,
+			Script::StringObject(info->compilerName));
+	}
+}
+
+void LanguageInfo::resetGenerated()
+{
+	for (std::map<string, LanguageInfo*>::const_iterator it = sData.begin();
+		 it != sData.end(); it++)
+		it->second->fGenerated = false;
+}
+
 LanguageInfo* LanguageInfo::getLanguageInfo(string langName)
 {
 	if (sData.count(langName) != 0)
 		return sData[langName];
 
-	// FIXME: this is bootstrap-only Phoenix, load hardcoded location
-	Object info = Script::Run(sStack,
-		FSUtil::combinePaths({FSUtil::parentDirectory(__FILE__),
-			"../../data/languages/" + langName + ".phnx"}));
+	Object info = loadDefinition(langName);
+	if (info == nullptr) {
+		throw Script::Exception(Script::Exception::UserError,
+			"there is no language named '" + langName + "'");
+	}
 	LanguageInfo* langInfo = new LanguageInfo(langName, info);
 	sData.insert({langName, langInfo});
 	return langInfo;
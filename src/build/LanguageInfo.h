@@ -25,9 +25,25 @@ class LanguageInfo
 public:
 	// From command-line flags & the like.
 	static std::map<std::string, std::string> sPreferredCompiler;
+	static std::vector<std::string> sLanguageDirs;
+	// Where test programs get written to and compiled in.
+	static std::string sProbeDirectory;
 
 	static Script::Stack* sStack;
 	static LanguageInfo* getLanguageInfo(std::string langName);
+	/*! Defines the superglobals of the languages detected so far on `stack`,
+	 * as detecting them again would have. */
+	static void addSuperglobals(Script::Stack* stack);
+	// Makes every language add its rules again, to a new Generator.
+	static void resetGenerated();
+
+	/*! Scans `scriptFile` for the languages it is likely to use, and starts
+	 * detecting their compilers in the background. */
+	static void prefetch(const std::string& scriptFile);
+	// Waits for all background checks to finish, and throws if any failed.
+	static void waitForChecks();
+	// Waits for all background checks to finish, discarding their results.
+	static void finishPending();
 
 	// Basic info
 	std::string name;
@@ -66,12 +82,36 @@ public:
 	void generate(Generator* gen);
 
 private:
+	friend class Snapshot;
+
 	LanguageInfo(std::string langName, Script::Object info);
+	LanguageInfo(); // for Snapshot
 
 	bool fGenerated;
 
+	struct PendingCheck {
+		OSUtil::PendingExec* exec;
+		std::string testName;
+	};
+	PendingCheck fWorksCheck;
+	void checkWorks();
+
+	PendingCheck startCheckIfCompiles(const std::string& testName,
+		const std::string& testContents, const std::string& extraFlags = "");
+	OSUtil::ExecResult finishCheckIfCompiles(const PendingCheck& check);
 	OSUtil::ExecResult checkIfCompiles(const std::string& testName,
 		const std::string& testContents, const std::string& extraFlags = "");
 
 	static std::map<std::string, LanguageInfo*> sData;
+	static std::map<std::string, Script::Object> sDefinitions;
+	static Script::Object loadDefinition(const std::string& langName);
+
+	static std::vector<std::string> candidateBinaries(const std::string& langName,
+		Script::Object info);
+	static const OSUtil::ExecResult& detectCompiler(const std::string& binary,
+		const std::string& arguments);
+	static std::map<std::pair<std::string, std::string>, OSUtil::ExecResult>
+		sDetectResults;
+	static std::map<std::pair<std::string, std::string>, OSUtil::PendingExec*>
+		sPendingDetects;
 };
@@ -0,0 +1,904 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "Snapshot.h"
+
+#include <cinttypes>
+#include <map>
+
+#include "Phoenix.h"
+#include "build/LanguageInfo.h"
+#include "build/Target.h"
+#include "script/Function.h"
+#include "script/Interpreter.h"
+#include "script/Recorder.h"
+#include "script/Stack.h"
+#include "util/FSUtil.h"
+#include "util/OSUtil.h"
+#include "util/PrintUtil.h"
+#include "util/StringUtil.h"
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+using Script::Object;
+using Script::Type;
+
+const char* Snapshot::kFileName = "phoenix.snapshot";
+string Snapshot::sProjectName;
+Script::Recorder* Snapshot::sRecorder = nullptr;
+vector<Snapshot::Search> Snapshot::sSearches;
+vector<Snapshot::Dependency> Snapshot::sDependencies;
+vector<Snapshot::Output> Snapshot::sOutputs;
+vector<string> Snapshot::sInputFiles;
+vector<uint64_t> Snapshot::sInputHashes;
+vector<uint64_t> Snapshot::sDependencyHashes;
+vector<Snapshot::Region> Snapshot::sRegions;
+set<int32_t> Snapshot::sChanged;
+
+// Bump when the layout below changes.
+static const string kSnapshotMagic = "PHNXSNAP4";
+
+static void Snapshot_put(string& out, uint64_t value)
+{
+	// LEB128, so small numbers (i.e. most of them) take a single byte.
+	do {
+		unsigned char byte = value & 0x7F;
+		value >>= 7;
+		if (value != 0)
+			byte |= 0x80;
+		out += (char)byte;
+	} while (value != 0);
+}
+static void Snapshot_put(string& out, const string& value)
+{
+	Snapshot_put(out, (uint64_t)value.length());
+	out += value;
+}
+static void Snapshot_put(string& out, const vector<string>& value)
+{
+	Snapshot_put(out, (uint64_t)value.size());
+	for (const string& str : value)
+		Snapshot_put(out, str);
+}
+static void Snapshot_put(string& out, const vector<Path>& value)
+{
+	Snapshot_put(out, (uint64_t)value.size());
+	for (const Path& path : value)
+		Snapshot_put(out, path.str());
+}
+// Returns false for values that cannot be restored (native functions.)
+static bool Snapshot_putValue(string& out, const Object& value)
+{
+	if (value == nullptr) {
+		Snapshot_put(out, (uint64_t)Type::Undefined);
+		return true;
+	}
+	Snapshot_put(out, (uint64_t)value->type());
+	switch (value->type()) {
+	case Type::Undefined:
+		return true;
+	case Type::Boolean:
+		Snapshot_put(out, value->boolean ? 1 : 0);
+		return true;
+	case Type::Integer:
+		Snapshot_put(out, (uint64_t)(uint32_t)value->integer);
+		return true;
+	case Type::String:
+		Snapshot_put(out, value->string);
+		return true;
+	case Type::Function:
+		if (value->function->isNative())
+			return false;
+		Snapshot_put(out, value->function->code().str());
+		Snapshot_put(out, value->function->file());
+		Snapshot_put(out, value->function->line());
+		return true;
+	case Type::List:
+		Snapshot_put(out, (uint64_t)value->list->size());
+		for (const Object item : *value->list) {
+			if (!Snapshot_putValue(out, item))
+				return false;
+		}
+		return true;
+	case Type::Map:
+		Snapshot_put(out, (uint64_t)value->map->size());
+		for (Script::ObjectMap::const_iterator it = value->map->begin(); it != value->map->end(); it++) {
+			Snapshot_put(out, it->first);
+			if (!Snapshot_putValue(out, it->second))
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
+static uint64_t Snapshot_hashFile(const string& file)
+{
+	// Distinguishes a missing file from an empty one.
+	return FSUtil::isFile(file) ? StringUtil::hash(FSUtil::getContents(file)) : 0;
+}
+
+class SnapshotReader
+{
+public:
+	SnapshotReader(const string& data) : fData(data), fPos(0), fOK(true) {}
+	inline bool ok() const { return fOK; }
+	inline bool atEnd() const { return fPos == fData.length(); }
+
+	uint64_t integer() {
+		uint64_t ret = 0;
+		for (int shift = 0; fOK; shift += 7) {
+			if (fPos >= fData.length() || shift > 63) {
+				fOK = false;
+				break;
+			}
+			const unsigned char byte = fData[fPos++];
+			ret |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		return ret;
+	}
+	string str() {
+		const uint64_t length = integer();
+		if (!fOK || length > fData.length() - fPos) {
+			fOK = false;
+			return "";
+		}
+		fPos += length;
+		return fData.substr(fPos - length, length);
+	}
+	vector<string> strings() {
+		vector<string> ret;
+		for (uint64_t count = integer(); fOK && count > 0; count--)
+			ret.push_back(str());
+		return ret;
+	}
+	vector<Path> paths() {
+		vector<Path> ret;
+		for (uint64_t count = integer(); fOK && count > 0; count--)
+			ret.push_back(Path(str()));
+		return ret;
+	}
+	Object value() {
+		Object ret;
+		switch ((Type)integer()) {
+		case Type::Undefined:
+			return Script::UndefinedObject();
+		case Type::Boolean:
+			return Script::BooleanObject(integer() != 0);
+		case Type::Integer:
+			return Script::IntegerObject((int32_t)(uint32_t)integer());
+		case Type::String:
+			return Script::StringObject(str());
+		case Type::Function: {
+			const string code = str(), file = str();
+			return Script::FunctionObject(new Script::Function(code, file, integer()));
+		}
+		case Type::List:
+			ret = Script::ListObject(new Script::ObjectList);
+			for (uint64_t count = integer(); fOK && count > 0; count--)
+				ret->list->push_back(value());
+			return ret;
+		case Type::Map:
+			ret = Script::MapObject(new Script::ObjectMap);
+			for (uint64_t count = integer(); fOK && count > 0; count--) {
+				const string key = str();
+				ret->map->set_ptr(key, value());
+			}
+			return ret;
+		}
+		fOK = false;
+		return Script::UndefinedObject();
+	}
+
+private:
+	const string& fData;
+	string::size_type fPos;
+	bool fOK;
+};
+
+void Snapshot::recordProjectName(const string& name)
+{
+	sProjectName = name;
+}
+
+void Snapshot::recordSearch(int32_t region, const string& directory,
+	const vector<string>& extensions, bool recursive, const vector<string>& results,
+	const vector<string>& directories)
+{
+	sSearches.push_back({region, directory, extensions, recursive, results, directories});
+}
+
+void Snapshot::startRecording()
+{
+	if (sRecorder == nullptr)
+		sRecorder = new Script::Recorder;
+}
+
+void Snapshot::_convert(const Script::Recorder& recorder, vector<Region>& regions,
+	vector<Dependency>& dependencies, vector<Output>& outputs)
+{
+	for (const Script::Recorder::Region& from : recorder.regions()) {
+		Region region;
+		region.path = from.path;
+		region.file = from.file;
+		region.directories = from.directories;
+		region.parent = from.parent;
+		region.standalone = from.standalone;
+		for (map<string, Object>::const_iterator it = from.reads.begin();
+				it != from.reads.end() && region.standalone; it++) {
+			string value;
+			region.standalone = Snapshot_putValue(value, it->second);
+			region.reads.push_back({it->first, value});
+		}
+		if (!region.standalone)
+			region.reads.clear();
+		region.writes.insert(region.writes.end(), from.writes.begin(), from.writes.end());
+		region.firstInputFile = from.firstInputFile;
+		region.inputFiles = from.inputFiles;
+		region.firstTarget = from.firstEffect;
+		region.targets = from.effects;
+		region.firstOutput = from.firstOutput;
+		region.outputs = from.outputs;
+		regions.push_back(region);
+	}
+	for (const std::pair<string, int32_t>& file : recorder.files())
+		dependencies.push_back({file.second, file.first});
+	for (const Script::Recorder::Output& output : recorder.outputs())
+		outputs.push_back({(uint64_t)output.kind, output.file, output.contents});
+}
+
+// The environment variables that influence which compilers get picked.
+static map<string, string> Snapshot_environment(const vector<string>& compilerEnvirons)
+{
+	map<string, string> ret;
+	ret["PATH"] = OSUtil::getEnv("PATH");
+	for (const string& name : compilerEnvirons) {
+		if (!name.empty())
+			ret[name] = OSUtil::getEnv(name);
+	}
+	return ret;
+}
+
+void Snapshot::commit(const vector<string>& inputFiles)
+{
+	if (sRecorder != nullptr) {
+		sRegions.clear();
+		sDependencies.clear();
+		sOutputs.clear();
+		_convert(*sRecorder, sRegions, sDependencies, sOutputs);
+		delete sRecorder;
+		sRecorder = nullptr;
+	}
+
+	sInputFiles = inputFiles;
+	sInputHashes.clear();
+	for (const string& input : inputFiles)
+		sInputHashes.push_back(Snapshot_hashFile(input));
+	sDependencyHashes.clear();
+	for (const Dependency& dependency : sDependencies)
+		sDependencyHashes.push_back(Snapshot_hashFile(dependency.file));
+}
+
+bool Snapshot::save(const string& file, const string& commandLine,
+	const vector<string>& inputFiles)
+{
+	commit(inputFiles);
+
+	string out = kSnapshotMagic;
+	Snapshot_put(out, PHOENIX_VERSION);
+	Snapshot_put(out, commandLine);
+
+	Snapshot_put(out, (uint64_t)sInputFiles.size());
+	for (vector<string>::size_type i = 0; i < sInputFiles.size(); i++) {
+		Snapshot_put(out, sInputFiles[i]);
+		Snapshot_put(out, sInputHashes[i]);
+	}
+	Snapshot_put(out, (uint64_t)sDependencies.size());
+	for (vector<Dependency>::size_type i = 0; i < sDependencies.size(); i++) {
+		Snapshot_put(out, sDependencies[i].region);
+		Snapshot_put(out, sDependencies[i].file);
+		Snapshot_put(out, sDependencyHashes[i]);
+	}
+
+	vector<string> compilerEnvirons;
+	for (map<string, LanguageInfo*>::const_iterator it = LanguageInfo::sData.begin();
+		 it != LanguageInfo::sData.end(); it++)
+		compilerEnvirons.push_back(it->second->compilerEnviron);
+	const map<string, string> environment = Snapshot_environment(compilerEnvirons);
+	Snapshot_put(out, (uint64_t)environment.size());
+	for (map<string, string>::const_iterator it = environment.begin();
+		 it != environment.end(); it++) {
+		Snapshot_put(out, it->first);
+		Snapshot_put(out, it->second);
+	}
+
+	Snapshot_put(out, (uint64_t)sSearches.size());
+	for (const Search& search : sSearches) {
+		Snapshot_put(out, search.region);
+		Snapshot_put(out, search.directory);
+		Snapshot_put(out, search.extensions);
+		Snapshot_put(out, search.recursive ? 1 : 0);
+		Snapshot_put(out, search.results);
+		Snapshot_put(out, search.directories);
+	}
+	Snapshot_put(out, (uint64_t)sOutputs.size());
+	for (const Output& output : sOutputs) {
+		Snapshot_put(out, output.kind);
+		Snapshot_put(out, output.file);
+		Snapshot_put(out, output.contents);
+	}
+
+	Snapshot_put(out, (uint64_t)sRegions.size());
+	for (const Region& region : sRegions) {
+		Snapshot_put(out, region.path);
+		Snapshot_put(out, region.file);
+		Snapshot_put(out, region.directories);
+		Snapshot_put(out, region.parent);
+		Snapshot_put(out, region.standalone ? 1 : 0);
+		Snapshot_put(out, (uint64_t)region.reads.size());
+		for (const std::pair<string, string>& read : region.reads) {
+			Snapshot_put(out, read.first);
+			Snapshot_put(out, read.second);
+		}
+		Snapshot_put(out, region.writes);
+		Snapshot_put(out, region.firstInputFile);
+		Snapshot_put(out, region.inputFiles);
+		Snapshot_put(out, region.firstTarget);
+		Snapshot_put(out, region.targets);
+		Snapshot_put(out, region.firstOutput);
+		Snapshot_put(out, region.outputs);
+	}
+
+	// The build model itself.
+	Snapshot_put(out, sProjectName);
+	Snapshot_put(out, (uint64_t)LanguageInfo::sData.size());
+	for (map<string, LanguageInfo*>::const_iterator it = LanguageInfo::sData.begin();
+		 it != LanguageInfo::sData.end(); it++) {
+		const LanguageInfo* info = it->second;
+		Snapshot_put(out, info->name);
+		Snapshot_put(out, info->genName);
+		Snapshot_put(out, info->sourceExtensions);
+		Snapshot_put(out, info->extraExtensions);
+		Snapshot_put(out, info->compilerEnviron);
+		Snapshot_put(out, info->compilerName);
+		Snapshot_put(out, info->compilerBinary);
+		Snapshot_put(out, info->compilerDefaultFlags);
+		Snapshot_put(out, info->compilerDependenciesFlag);
+		Snapshot_put(out, (uint64_t)info->compilerDependencyFormat);
+		Snapshot_put(out, info->compilerDependencyPrefix);
+		Snapshot_put(out, info->compilerCompileFlag);
+		Snapshot_put(out, info->compilerOutputFlag);
+		Snapshot_put(out, info->compilerOutputExtension);
+		Snapshot_put(out, info->compilerLinkBinaryFlag);
+		Snapshot_put(out, info->compilerDefinition);
+		Snapshot_put(out, info->compilerInclude);
+		Snapshot_put(out, (uint64_t)info->standardsModes.size());
+		for (map<string, LanguageInfo::StandardsMode>::const_iterator mode =
+			 info->standardsModes.begin(); mode != info->standardsModes.end(); mode++) {
+			Snapshot_put(out, mode->first);
+			Snapshot_put(out, mode->second.test);
+			Snapshot_put(out, mode->second.normalFlag);
+			Snapshot_put(out, mode->second.strictFlag);
+			Snapshot_put(out, (uint64_t)(mode->second.status + 1));
+		}
+	}
+	Snapshot_put(out, (uint64_t)Target::targets.size());
+	for (const Target* target : Target::targets) {
+		Snapshot_put(out, target->name);
+		Snapshot_put(out, target->languages);
+		Snapshot_put(out, target->standardsModeFlag);
+		Snapshot_put(out, target->definitionsFlags);
+		Snapshot_put(out, target->includeDirs);
+		Snapshot_put(out, target->otherFlags);
+		Snapshot_put(out, target->sourceFiles);
+		Snapshot_put(out, target->extraFiles);
+	}
+
+	return FSUtil::setContents(file, out);
+}
+
+Snapshot::Result Snapshot::load(const string& file, const string& commandLine,
+	vector<string>& inputFiles, string& projectName)
+{
+	if (!FSUtil::isFile(file))
+		return Stale;
+	string data = FSUtil::getContents(file);
+	if (!StringUtil::startsWith(data, kSnapshotMagic))
+		return Stale;
+	data.erase(0, kSnapshotMagic.length());
+	SnapshotReader in(data);
+	if (in.str() != PHOENIX_VERSION || in.str() != commandLine)
+		return Stale;
+
+	vector<string> inputs;
+	vector<uint64_t> inputHashes;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		inputs.push_back(in.str());
+		inputHashes.push_back(in.integer());
+	}
+	vector<Dependency> dependencies;
+	vector<uint64_t> dependencyHashes;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		Dependency dependency;
+		dependency.region = in.integer();
+		dependency.file = in.str();
+		dependencies.push_back(dependency);
+		dependencyHashes.push_back(in.integer());
+	}
+	map<string, string> environment;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		const string name = in.str();
+		environment[name] = in.str();
+	}
+	vector<Search> searches;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		Search search;
+		search.region = in.integer();
+		search.directory = in.str();
+		search.extensions = in.strings();
+		search.recursive = in.integer() != 0;
+		search.results = in.strings();
+		search.directories = in.strings();
+		searches.push_back(search);
+	}
+	vector<Output> outputs;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		Output output;
+		output.kind = in.integer();
+		output.file = in.str();
+		output.contents = in.str();
+		outputs.push_back(output);
+	}
+	vector<Region> regions;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		Region region;
+		region.path = in.str();
+		region.file = in.str();
+		region.directories = in.strings();
+		region.parent = in.integer();
+		region.standalone = in.integer() != 0;
+		for (uint64_t reads = in.integer(); in.ok() && reads > 0; reads--) {
+			const string name = in.str();
+			region.reads.push_back({name, in.str()});
+		}
+		region.writes = in.strings();
+		region.firstInputFile = in.integer();
+		region.inputFiles = in.integer();
+		region.firstTarget = in.integer();
+		region.targets = in.integer();
+		region.firstOutput = in.integer();
+		region.outputs = in.integer();
+		if (region.parent < 0 || (size_t)region.parent >= std::max<size_t>(regions.size(), 1) ||
+				region.firstOutput + region.outputs > outputs.size())
+			return Stale;
+		regions.push_back(region);
+	}
+	if (!in.ok() || regions.empty())
+		return Stale;
+	for (const Dependency& dependency : dependencies) {
+		if (dependency.region < 0 || (size_t)dependency.region >= regions.size())
+			return Stale;
+	}
+	for (const Search& search : searches) {
+		if (search.region < 0 || (size_t)search.region >= regions.size())
+			return Stale;
+	}
+
+	for (map<string, string>::const_iterator it = environment.begin();
+		 it != environment.end(); it++) {
+		if (OSUtil::getEnv(it->first) != it->second)
+			return Stale;
+	}
+
+	set<int32_t> stale;
+	if (!_findChanged(inputs, inputHashes, dependencies, dependencyHashes, searches,
+			regions, stale))
+		return Stale;
+
+	// Read the build model.
+	const string savedProjectName = in.str();
+	vector<LanguageInfo*> languages;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		LanguageInfo* info = new LanguageInfo;
+		info->name = in.str();
+		info->genName = in.str();
+		info->sourceExtensions = in.strings();
+		info->extraExtensions = in.strings();
+		info->compilerEnviron = in.str();
+		info->compilerName = in.str();
+		info->compilerBinary = in.str();
+		info->compilerDefaultFlags = in.str();
+		info->compilerDependenciesFlag = in.str();
+		info->compilerDependencyFormat = (Generator::DependencyFormat)in.integer();
+		info->compilerDependencyPrefix = in.str();
+		info->compilerCompileFlag = in.str();
+		info->compilerOutputFlag = in.str();
+		info->compilerOutputExtension = in.str();
+		info->compilerLinkBinaryFlag = in.str();
+		info->compilerDefinition = in.str();
+		info->compilerInclude = in.str();
+		for (uint64_t modes = in.integer(); in.ok() && modes > 0; modes--) {
+			const string modeName = in.str();
+			LanguageInfo::StandardsMode mode;
+			mode.test = in.str();
+			mode.normalFlag = in.str();
+			mode.strictFlag = in.str();
+			mode.status = (int8_t)in.integer() - 1;
+			info->standardsModes.insert({modeName, mode});
+		}
+		languages.push_back(info);
+	}
+	vector<Target*> targets;
+	for (uint64_t count = in.integer(); in.ok() && count > 0; count--) {
+		Target* target = new Target;
+		target->name = in.str();
+		target->languages = in.strings();
+		target->standardsModeFlag = in.str();
+		target->definitionsFlags = in.str();
+		target->includeDirs = in.paths();
+		target->otherFlags = in.str();
+		target->sourceFiles = in.paths();
+		target->extraFiles = in.paths();
+		targets.push_back(target);
+	}
+	if (!in.ok() || !in.atEnd()) {
+		for (LanguageInfo* info : languages)
+			delete info;
+		for (Target* target : targets)
+			delete target;
+		return Stale;
+	}
+
+	for (LanguageInfo* info : languages)
+		LanguageInfo::sData.insert({info->name, info});
+	Target::targets.insert(Target::targets.end(), targets.begin(), targets.end());
+	sProjectName = projectName = savedProjectName;
+	sSearches = searches;
+	sDependencies = dependencies;
+	sOutputs = outputs;
+	sRegions = regions;
+	sChanged = stale;
+	sInputFiles = inputFiles = inputs;
+	sInputHashes = inputHashes;
+	sDependencyHashes = dependencyHashes;
+	return stale.empty() ? Unchanged : Changed;
+}
+
+Snapshot::Result Snapshot::refresh(vector<string>& inputFiles, string& projectName)
+{
+	if (sRegions.empty())
+		return Stale;
+	set<int32_t> stale;
+	if (!_findChanged(sInputFiles, sInputHashes, sDependencies, sDependencyHashes, sSearches,
+			sRegions, stale))
+		return Stale;
+	sChanged = stale;
+	inputFiles = sInputFiles;
+	projectName = sProjectName;
+	return stale.empty() ? Unchanged : Changed;
+}
+
+bool Snapshot::_findChanged(const vector<string>& inputs, const vector<uint64_t>& inputHashes,
+	const vector<Dependency>& dependencies, const vector<uint64_t>& dependencyHashes,
+	const vector<Search>& searches, const vector<Region>& regions, set<int32_t>& stale)
+{
+	// Find what changed, and the regions it happened in.
+	set<int32_t> changed;
+	for (vector<string>::size_type i = 0; i < inputs.size(); i++) {
+		if (Snapshot_hashFile(inputs[i]) == inputHashes[i])
+			continue;
+		// The innermost region the file was evaluated in.
+		int32_t innermost = 0;
+		for (vector<Region>::size_type r = 1; r < regions.size(); r++) {
+			if (i >= regions[r].firstInputFile && i < regions[r].firstInputFile + regions[r].inputFiles)
+				innermost = r;
+		}
+		changed.insert(innermost);
+	}
+	for (vector<Dependency>::size_type i = 0; i < dependencies.size(); i++) {
+		if (Snapshot_hashFile(dependencies[i].file) != dependencyHashes[i])
+			changed.insert(dependencies[i].region);
+	}
+	for (const Search& search : searches) {
+		vector<string> directories;
+		if (FSUtil::searchForFiles(search.directory, search.extensions, search.recursive,
+				&directories) != search.results || directories != search.directories)
+			changed.insert(search.region);
+	}
+
+	// Each change has to be re-evaluated as part of the innermost standalone
+	// region around it, and only once.
+	stale.clear();
+	for (int32_t region : changed) {
+		while (region != 0 && !regions[region].standalone)
+			region = regions[region].parent;
+		if (region == 0)
+			return false;
+		stale.insert(region);
+	}
+	for (set<int32_t>::iterator it = stale.begin(); it != stale.end(); ) {
+		int32_t region = regions[*it].parent;
+		while (region != 0 && stale.count(region) == 0)
+			region = regions[region].parent;
+		if (region != 0)
+			it = stale.erase(it);
+		else
+			it++;
+	}
+	return true;
+}
+
+void Snapshot::reset()
+{
+	for (Target* target : Target::targets)
+		delete target;
+	Target::targets.clear();
+	delete sRecorder;
+	sRecorder = nullptr;
+	sProjectName.clear();
+	sSearches.clear();
+	sDependencies.clear();
+	sOutputs.clear();
+	sRegions.clear();
+	sChanged.clear();
+	sInputFiles.clear();
+	sInputHashes.clear();
+	sDependencyHashes.clear();
+}
+
+void Snapshot::dependencies(vector<string>& files, vector<string>& directories)
+{
+	for (const Dependency& dependency : sDependencies)
+		files.push_back(dependency.file);
+	if (sRecorder != nullptr) {
+		for (const std::pair<string, int32_t>& file : sRecorder->files())
+			files.push_back(file.first);
+	}
+	for (const Search& search : sSearches) {
+		directories.insert(directories.end(), search.directories.begin(),
+			search.directories.end());
+	}
+}
+
+vector<Generator::Glob> Snapshot::globs()
+{
+	vector<Generator::Glob> ret;
+	for (const Search& search : sSearches) {
+		ret.push_back({search.directory, search.extensions, search.recursive, search.results,
+			search.directories});
+	}
+	return ret;
+}
+
+void Snapshot::replay()
+{
+	// The regions being evaluated again do their own.
+	vector<bool> skip(sOutputs.size(), false);
+	for (int32_t r : sChanged) {
+		for (uint64_t i = 0; i < sRegions[r].outputs; i++)
+			skip[sRegions[r].firstOutput + i] = true;
+	}
+	for (vector<Output>::size_type i = 0; i < sOutputs.size(); i++) {
+		if (skip[i])
+			continue;
+		const Output& output = sOutputs[i];
+		switch ((Script::Recorder::Output::Kind)output.kind) {
+		case Script::Recorder::Output::Write:
+			FSUtil::setContentsIfChanged(output.file, output.contents);
+			break;
+		case Script::Recorder::Output::Remove:
+			FSUtil::deleteFile(output.file);
+			break;
+		case Script::Recorder::Output::Print:
+			PrintUtil::message(output.file);
+			break;
+		}
+	}
+}
+
+bool Snapshot::reevaluate(const std::function<Script::Stack*()>& createStack,
+	vector<string>& inputFiles)
+{
+	struct Reevaluation {
+		int32_t region;
+		vector<Target*> targets;
+		vector<string> inputFiles;
+		vector<Region> regions;
+		vector<Search> searches;
+		vector<Dependency> dependencies;
+		vector<Output> outputs;
+	};
+	vector<Reevaluation> reevaluations;
+	vector<Target*> targets;
+	targets.swap(Target::targets);
+	vector<Search> searches;
+	searches.swap(sSearches);
+	vector<Dependency> dependencies;
+	dependencies.swap(sDependencies);
+	Script::Stack* languageStack = LanguageInfo::sStack;
+
+	// Evaluate all of them before changing anything, in case one can't be.
+	bool ok = true;
+	for (int32_t r : sChanged) {
+		const Region& region = sRegions[r];
+		Script::Stack* stack = createStack();
+		for (const string& directory : region.directories)
+			stack->pushDir(directory);
+		LanguageInfo::addSuperglobals(stack);
+		for (const std::pair<string, string>& read : region.reads) {
+			SnapshotReader in(read.second);
+			Object value = in.value();
+			if (value->type() != Type::Undefined)
+				stack->set_ptr({read.first}, value);
+		}
+
+		Reevaluation reevaluation;
+		reevaluation.region = r;
+		Script::Recorder recorder;
+		LanguageInfo::sStack = stack;
+		bool failed = false;
+		try {
+			Script::Recorder::enter(stack, region.path, region.file);
+			Object result = Script::Run(stack, region.path);
+			Script::Recorder::leave(stack, result);
+		} catch (Script::Exception&) {
+			// Maybe it now depends on something it didn't; the full run will
+			// report the error if it is a real one.
+			failed = true;
+		}
+		LanguageInfo::sStack = languageStack;
+		reevaluation.targets.swap(Target::targets);
+		if (failed) {
+			reevaluations.push_back(reevaluation);
+			delete stack;
+			ok = false;
+			break;
+		}
+		reevaluation.inputFiles = stack->inputFiles();
+		_convert(recorder, reevaluation.regions, reevaluation.dependencies, reevaluation.outputs);
+		reevaluation.searches.swap(sSearches);
+		reevaluations.push_back(reevaluation);
+		delete stack;
+
+		// It must not have read or assigned anything from outside it didn't before.
+		const Region& now = reevaluation.regions[1];
+		ok = now.standalone;
+		set<string> names;
+		for (const std::pair<string, string>& read : region.reads)
+			names.insert(read.first);
+		for (const std::pair<string, string>& read : now.reads)
+			ok = ok && names.count(read.first) != 0;
+		names = set<string>(region.writes.begin(), region.writes.end());
+		for (const string& name : now.writes)
+			ok = ok && names.count(name) != 0;
+		if (!ok)
+			break;
+	}
+	if (!ok) {
+		Target::targets = targets;
+		for (const Reevaluation& reevaluation : reevaluations) {
+			Target::targets.insert(Target::targets.end(), reevaluation.targets.begin(),
+				reevaluation.targets.end());
+		}
+		reset();
+		return false;
+	}
+	replay();
+
+	// Splice in the targets, input files and outputs they produced, in order.
+	vector<string> files;
+	files.swap(inputFiles);
+	vector<Output> outputs;
+	outputs.swap(sOutputs);
+	uint64_t nextTarget = 0, nextFile = 0, nextOutput = 0;
+	for (const Reevaluation& reevaluation : reevaluations) {
+		const Region& region = sRegions[reevaluation.region];
+		Target::targets.insert(Target::targets.end(), targets.begin() + nextTarget,
+			targets.begin() + region.firstTarget);
+		Target::targets.insert(Target::targets.end(), reevaluation.targets.begin(),
+			reevaluation.targets.end());
+		nextTarget = region.firstTarget + region.targets;
+		for (uint64_t i = region.firstTarget; i < nextTarget; i++)
+			delete targets[i];
+
+		inputFiles.insert(inputFiles.end(), files.begin() + nextFile,
+			files.begin() + region.firstInputFile);
+		inputFiles.insert(inputFiles.end(), reevaluation.inputFiles.begin(),
+			reevaluation.inputFiles.end());
+		nextFile = region.firstInputFile + region.inputFiles;
+
+		sOutputs.insert(sOutputs.end(), outputs.begin() + nextOutput,
+			outputs.begin() + region.firstOutput);
+		sOutputs.insert(sOutputs.end(), reevaluation.outputs.begin(),
+			reevaluation.outputs.end());
+		nextOutput = region.firstOutput + region.outputs;
+	}
+	Target::targets.insert(Target::targets.end(), targets.begin() + nextTarget, targets.end());
+	inputFiles.insert(inputFiles.end(), files.begin() + nextFile, files.end());
+	sOutputs.insert(sOutputs.end(), outputs.begin() + nextOutput, outputs.end());
+
+	// And their regions in place of the ones they had, which moves the
+	// targets, input files and outputs of those after (or around) them.
+	vector<Region> regions;
+	vector<int32_t> index(sRegions.size(), -1);
+	for (vector<Region>::size_type r = 0; r < sRegions.size(); r++) {
+		int32_t replaced = -1;
+		int64_t targetShift = 0, fileShift = 0, outputShift = 0;
+		int64_t targetGrowth = 0, fileGrowth = 0, outputGrowth = 0;
+		for (vector<Reevaluation>::size_type k = 0; k < reevaluations.size(); k++) {
+			const int32_t region = reevaluations[k].region;
+			const Region& now = reevaluations[k].regions[1];
+			const int64_t targets = (int64_t)now.targets - (int64_t)sRegions[region].targets,
+				files = (int64_t)now.inputFiles - (int64_t)sRegions[region].inputFiles,
+				outputs = (int64_t)now.outputs - (int64_t)sRegions[region].outputs;
+			if (Script::Recorder::within(sRegions, r, region)) {
+				replaced = k;
+			} else if (Script::Recorder::within(sRegions, region, r)) {
+				targetGrowth += targets;
+				fileGrowth += files;
+				outputGrowth += outputs;
+			} else if (region < (int32_t)r) {
+				targetShift += targets;
+				fileShift += files;
+				outputShift += outputs;
+			}
+		}
+		if (replaced < 0) {
+			Region region = sRegions[r];
+			if (r != 0) {
+				region.parent = index[region.parent];
+				region.firstTarget += targetShift;
+				region.firstInputFile += fileShift;
+				region.firstOutput += outputShift;
+				region.targets += targetGrowth;
+				region.inputFiles += fileGrowth;
+				region.outputs += outputGrowth;
+			}
+			index[r] = regions.size();
+			regions.push_back(region);
+			continue;
+		}
+		if (reevaluations[replaced].region != (int32_t)r)
+			continue;
+
+		// The re-evaluation's region 0 stands for everything around it.
+		const Reevaluation& reevaluation = reevaluations[replaced];
+		const Region& old = sRegions[r];
+		const int32_t base = regions.size() - 1;
+		const std::function<int32_t(int32_t)> place = [&](int32_t region) {
+			return region == 0 ? index[old.parent] : base + region;
+		};
+		for (vector<Region>::size_type n = 1; n < reevaluation.regions.size(); n++) {
+			Region region = reevaluation.regions[n];
+			region.parent = place(region.parent);
+			region.firstTarget += old.firstTarget + targetShift;
+			region.firstInputFile += old.firstInputFile + fileShift;
+			region.firstOutput += old.firstOutput + outputShift;
+			regions.push_back(region);
+		}
+		for (Search search : reevaluation.searches) {
+			search.region = place(search.region);
+			sSearches.push_back(search);
+		}
+		for (const Dependency& dependency : reevaluation.dependencies)
+			sDependencies.push_back({place(dependency.region), dependency.file});
+	}
+
+	for (Search search : searches) {
+		if (index[search.region] >= 0) {
+			search.region = index[search.region];
+			sSearches.push_back(search);
+		}
+	}
+	for (const Dependency& dependency : dependencies) {
+		if (index[dependency.region] >= 0)
+			sDependencies.push_back({index[dependency.region], dependency.file});
+	}
+	sRegions = regions;
+	sChanged.clear();
+	return true;
+}
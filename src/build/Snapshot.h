@@ -0,0 +1,142 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "build/Generators.h"
+
+namespace Script { class Recorder; class Stack; }
+
+/*! Saves the build model (the targets, the languages they use and the project
+ * name) once the scripts have run, together with everything it was computed
+ * from, so that a rerun with the same inputs can skip evaluating them.
+ *
+ * The model is also split into the regions a Script::Recorder found, so that
+ * when only some subdirectories' inputs changed, just those are evaluated
+ * again and what they produce replaces what they did before. */
+class Snapshot
+{
+public:
+	static const char* kFileName;
+
+	// Things the build model depends on that aren't visible afterwards.
+	static void recordProjectName(const std::string& name);
+	static void recordSearch(int32_t region, const std::string& directory,
+		const std::vector<std::string>& extensions, bool recursive,
+		const std::vector<std::string>& results, const std::vector<std::string>& directories);
+	// Records the regions of the scripts evaluated from now on.
+	static void startRecording();
+
+	/*! Takes the build model as it is now, computed from `inputFiles` and the
+	 * files recorded alongside it, as the one later refresh()es compare
+	 * against. This ends recording. */
+	static void commit(const std::vector<std::string>& inputFiles);
+	// Commits the model (see above), and writes it to `file`.
+	static bool save(const std::string& file, const std::string& commandLine,
+		const std::vector<std::string>& inputFiles);
+
+	enum Result {
+		Stale = 0,
+		Changed,
+		Unchanged,
+	};
+	/*! Restores the build model from `file`, if it was saved with the same
+	 * command line by this version of Phoenix and the environment variables
+	 * that choose compilers are the same. `inputFiles` and `projectName` get
+	 * what was saved.
+	 *
+	 * Returns `Unchanged` if none of the scripts, files they read or searched
+	 * directories have changed since either; `Changed` if all of the ones that
+	 * did are in standalone regions, which reevaluate() must then be called
+	 * for; and `Stale` (restoring nothing) otherwise. */
+	static Result load(const std::string& file, const std::string& commandLine,
+		std::vector<std::string>& inputFiles, std::string& projectName);
+
+	/*! Evaluates the changed regions again, each on a new stack from
+	 * `createStack` with the variables it read restored, and splices what they
+	 * produce into the model. If one of them now depends on something from
+	 * outside it did not before, the model is reset() and false is returned,
+	 * in which case the scripts have to be run in full. */
+	static bool reevaluate(const std::function<Script::Stack*()>& createStack,
+		std::vector<std::string>& inputFiles);
+
+	/*! Does again what the scripts did besides computing the model (writing
+	 * and removing files, printing), for one load()ed or refresh()ed as
+	 * `Unchanged`. reevaluate() does this itself for the regions it does not
+	 * evaluate, after the ones it does. */
+	static void replay();
+
+	/*! Like load(), but compares against the last model commit()ted in this
+	 * process rather than a file, for `--watch`. `Stale` means the scripts
+	 * have to be run from scratch, after a reset(). */
+	static Result refresh(std::vector<std::string>& inputFiles, std::string& projectName);
+	// Forgets the build model, except for the languages, which stay detected.
+	static void reset();
+
+	/*! The files the build model depends on besides the scripts, and the
+	 * directories that were searched (including subdirectories.) */
+	static void dependencies(std::vector<std::string>& files,
+		std::vector<std::string>& directories);
+	// The searches for source files, as the generators take them.
+	static std::vector<Generator::Glob> globs();
+
+private:
+	struct Search {
+		int32_t region;
+		std::string directory;
+		std::vector<std::string> extensions;
+		bool recursive;
+		std::vector<std::string> results;
+		std::vector<std::string> directories;
+	};
+	struct Dependency {
+		int32_t region;
+		std::string file;
+	};
+	// A Script::Recorder::Output.
+	struct Output {
+		uint64_t kind;
+		std::string file;
+		std::string contents;
+	};
+	// A Script::Recorder::Region, with the variables it read serialized.
+	struct Region {
+		std::string path;
+		std::string file;
+		std::vector<std::string> directories;
+		int32_t parent;
+		bool standalone;
+		std::vector<std::pair<std::string, std::string> > reads;
+		std::vector<std::string> writes;
+		uint64_t firstInputFile, inputFiles;
+		uint64_t firstTarget, targets;
+		uint64_t firstOutput, outputs;
+	};
+
+	static void _convert(const Script::Recorder& recorder, std::vector<Region>& regions,
+		std::vector<Dependency>& dependencies, std::vector<Output>& outputs);
+	// Finds the regions that have to be re-evaluated. False if that's all of them.
+	static bool _findChanged(const std::vector<std::string>& inputs,
+		const std::vector<uint64_t>& inputHashes, const std::vector<Dependency>& dependencies,
+		const std::vector<uint64_t>& dependencyHashes, const std::vector<Search>& searches,
+		const std::vector<Region>& regions, std::set<int32_t>& stale);
+
+	static std::string sProjectName;
+	static Script::Recorder* sRecorder;
+	static std::vector<Search> sSearches;
+	static std::vector<Dependency> sDependencies;
+	static std::vector<Output> sOutputs;
+	// As of the last commit().
+	static std::vector<std::string> sInputFiles;
+	static std::vector<uint64_t> sInputHashes;
+	static std::vector<uint64_t> sDependencyHashes;
+	static std::vector<Region> sRegions;
+	static std::set<int32_t> sChanged;
+};
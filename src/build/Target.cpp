@@ -9,9 +9,11 @@
 #include "util/FSUtil.h"
 #include "util/PrintUtil.h"
 #include "util/StringUtil.h"
+#include "util/TraceUtil.h"
 
 #include "Generators.h"
 #include "LanguageInfo.h"
+#include "Snapshot.h"
 
 using std::vector;
 using Script::Exception;
@@ -27,7 +29,6 @@ std::vector<Target*> Target::targets;
 Target::Target(const ObjectMap& params)
 {
 	ObjectMap* map = fMapObject = new ObjectMap;
-	targets.push_back(this);
 
 	NativeFunction_COERCE_OR_THROW("0", nm, Type::String);
 	name = nm->asStringRaw();
@@ -89,10 +90,9 @@ Target::Target(const ObjectMap& params)
 	map->set("addSources", FunctionObject([this](Stack* stack,
 			Object, ObjectMap& params) -> Object {
 		NativeFunction_COERCE_OR_THROW("0", filesObj, Type::List);
-		for (const Object o : *filesObj->list) {
-			this->sourceFiles.push_back(FSUtil::absolutePath(FSUtil::combinePaths({
-				stack->currentDir(), o->asStringRaw()})));
-		}
+		const Path currentDir(stack->currentDir());
+		for (const Object o : *filesObj->list)
+			this->sourceFiles.push_back(currentDir.join(o->asStringRaw()).absolute());
 		return Script::UndefinedObject();
 	}));
 	map->set("addSourceDirectory", FunctionObject([this](Stack* stack, Object,
@@ -100,24 +100,31 @@ Target::Target(const ObjectMap& params)
 		// TODO: get rid of hardcoded languages[0]
 		LanguageInfo* info = LanguageInfo::getLanguageInfo(this->languages[0]);
 		NativeFunction_COERCE_OR_THROW("0", dirNameObj, Type::String);
-		std::string dirName = FSUtil::combinePaths({stack->currentDir(),
-			dirNameObj->asStringRaw()});
+		const std::string dirName = Path(stack->currentDir()).join(
+			dirNameObj->asStringRaw()).str();
 
 		bool recurse = params.get("recursive")->boolean;
+		vector<std::string> directories;
 		vector<std::string> newFiles =
-			FSUtil::searchForFiles(dirName, info->sourceExtensions, recurse);
-		for (vector<std::string>::size_type i = 0; i < newFiles.size(); i++)
-			newFiles[i] = FSUtil::absolutePath(newFiles[i]);
+			FSUtil::searchForFiles(dirName, info->sourceExtensions, recurse, &directories);
+		Snapshot::recordSearch(stack->region(), dirName, info->sourceExtensions, recurse, newFiles,
+			directories);
 
+		directories.clear();
 		vector<std::string> newExtraFiles =
-			FSUtil::searchForFiles(dirName, info->extraExtensions, recurse);
-		for (vector<std::string>::size_type i = 0; i < newExtraFiles.size(); i++)
-			newExtraFiles[i] = FSUtil::absolutePath(newExtraFiles[i]);
-
-		sourceFiles.insert(sourceFiles.end(), newFiles.begin(),
-			newFiles.end());
-		extraFiles.insert(extraFiles.end(), newExtraFiles.begin(),
-			newExtraFiles.end());
+			FSUtil::searchForFiles(dirName, info->extraExtensions, recurse, &directories);
+		Snapshot::recordSearch(stack->region(), dirName, info->extraExtensions, recurse,
+			newExtraFiles, directories);
+
+		// The results are already normalized, so this is all they go through.
+		FSUtil::absolutePaths(newFiles);
+		sourceFiles.reserve(sourceFiles.size() + newFiles.size());
+		for (const std::string& file : newFiles)
+			sourceFiles.push_back(Path(file));
+		FSUtil::absolutePaths(newExtraFiles);
+		extraFiles.reserve(extraFiles.size() + newExtraFiles.size());
+		for (const std::string& file : newExtraFiles)
+			extraFiles.push_back(Path(file));
 		return Script::UndefinedObject();
 	}));
 
@@ -125,14 +132,16 @@ Target::Target(const ObjectMap& params)
 			Object, ObjectMap& params) -> Object {
 		NativeFunction_COERCE_OR_THROW("0", dirsList, Type::List);
 
+		const Path currentDir(stack->currentDir());
 		for (const Object itm : *dirsList->list)
-			includeDirs.push_back(FSUtil::combinePaths({stack->currentDir(), itm->asStringRaw()}));
+			includeDirs.push_back(currentDir.join(itm->asStringRaw()));
 		return Script::UndefinedObject();
 	}));
 }
 
 void Target::generate(Generator* gen)
 {
+	TraceUtil::Span span("generate " + name, "target");
 	for (std::string lang : languages)
 		LanguageInfo::getLanguageInfo(lang)->generate(gen);
 	if (sourceFiles.size() == 0) {
@@ -143,8 +152,8 @@ void Target::generate(Generator* gen)
 	LanguageInfo* info = LanguageInfo::getLanguageInfo(this->languages[0]);
 
 	std::string includesFlags;
-	for (std::string dir : includeDirs)
-		includesFlags.append(" " + info->compilerInclude + "\"" + dir + "\"");
+	for (const Path& dir : includeDirs)
+		includesFlags.append(" " + info->compilerInclude + "\"" + dir.str() + "\"");
 
 	gen->addTarget("link" + LanguageInfo::getLanguageInfo(languages[0])->genName,
 		name + APPLICATION_FILE_EXT, sourceFiles,
@@ -160,6 +169,7 @@ void Target::addGlobalFunction(Script::Stack* stack)
 		if (stack->dirDepth() <= 1) {
 			NativeFunction_COERCE_OR_THROW("0", zero, Type::String);
 			Generators::actual->setProjectName(zero->string);
+			Snapshot::recordProjectName(zero->string);
 		}
 		Object langs = params.get("languages");
 		if (langs->type() == Type::List) {
@@ -172,8 +182,14 @@ void Target::addGlobalFunction(Script::Stack* stack)
 		}
 		return Script::UndefinedObject();
 	})});
-	stack->GlobalFunctions.insert({"CreateTarget", Function([](Stack*, Object, ObjectMap& params)
+	stack->GlobalFunctions.insert({"CreateTarget", Function([](Stack* stack, Object, ObjectMap& params)
 		-> Script::Object {
-		return Script::MapObject((new Target(params))->fMapObject);
+		Target* target = new Target(params);
+		// Keeps targets in declaration order when subdirectories run in parallel.
+		stack->defer([target]() {
+			targets.push_back(target);
+			Script::Recorder::effect();
+		});
+		return Script::MapObject(target->fMapObject);
 	})});
 }
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "script/Object.h"
+#include "util/Path.h"
 
 // Predefinitions
 class Generator;
@@ -23,14 +24,17 @@ public:
 	std::vector<std::string> languages;
 	std::string standardsModeFlag;
 	std::string definitionsFlags;
-	std::vector<std::string> includeDirs;
+	std::vector<Path> includeDirs;
 	std::string otherFlags;
-	std::vector<std::string> sourceFiles;
-	std::vector<std::string> extraFiles;
+	std::vector<Path> sourceFiles;
+	std::vector<Path> extraFiles;
 
 	void generate(Generator* gen);
 
 private:
+	friend class Snapshot;
+
 	Target(const Script::ObjectMap& params);
+	Target() : fMapObject(nullptr) {}
 	Script::ObjectMap* fMapObject;
 };
@@ -11,6 +11,7 @@
 #include "build/Target.h"
 #include "build/LanguageInfo.h"
 #include "util/FSUtil.h"
+#include "util/TraceUtil.h"
 #include "util/XmlUtil.h"
 
 using std::string;
@@ -44,7 +45,7 @@ void CodeBlocksGenerator::setBuildScriptFiles(const string&, const vector<string
 }
 
 void CodeBlocksGenerator::addTarget(const string&, const string& outputBinaryName,
-	const vector<string>& inputFiles, const string&, const Target* target)
+	const vector<Path>& inputFiles, const string&, const Target* target)
 {
 	// TODO: get rid of hardcoded languages[0]?
 	std::string compiler = LanguageInfo::getLanguageInfo(target->languages[0])->compilerName;
@@ -54,23 +55,24 @@ void CodeBlocksGenerator::addTarget(const string&, const string& outputBinaryNam
 
 	CodeBlocksTarget t;
 	t.name = outputBinaryName;
-	t.includeDirs = target->includeDirs;
+	for (const Path& dir : target->includeDirs)
+		t.includeDirs.push_back(dir.str());
 	t.compiler = compiler;
 	fTargets.push_back(t);
 
-	for (string file : inputFiles) {
-		_multimap::iterator it = fFilesAndTargets.find(file);
+	for (const Path& file : inputFiles) {
+		_multimap::iterator it = fFilesAndTargets.find(file.str());
 		if (it != fFilesAndTargets.end())
 			it->second.push_back(outputBinaryName);
 		else
-			fFilesAndTargets.insert({file, {outputBinaryName}});
+			fFilesAndTargets.insert({file.str(), {outputBinaryName}});
 	}
-	for (string file : target->extraFiles) {
-		_multimap::iterator it = fFilesAndTargets.find(file);
+	for (const Path& file : target->extraFiles) {
+		_multimap::iterator it = fFilesAndTargets.find(file.str());
 		if (it != fFilesAndTargets.end())
 			it->second.push_back(outputBinaryName);
 		else
-			fFilesAndTargets.insert({file, {outputBinaryName}});
+			fFilesAndTargets.insert({file.str(), {outputBinaryName}});
 	}
 }
 
@@ -80,6 +82,7 @@ vector<string> CodeBlocksGenerator::outputFiles()
 }
 void CodeBlocksGenerator::write()
 {
+	TraceUtil::Span span("write " + fName + ".cbp", "generator");
 	XmlGenerator gen("CodeBlocks_project_file");
 	gen.beginTag("FileVersion", {{"major", "1"}, {"minor", "6"}}, true);
 	gen.beginTag("Project");
@@ -133,5 +136,5 @@ void CodeBlocksGenerator::write()
 		if (!it->second.empty())
 			gen.endTag("Unit");
 	}
-	FSUtil::setContents(fName + ".cbp", gen.finish());
+	FSUtil::setContentsIfChanged(fName + ".cbp", gen.finish());
 }
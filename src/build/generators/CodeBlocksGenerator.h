@@ -34,7 +34,7 @@ public:
 
 	virtual void addTarget(const std::string&,
 	    const std::string& outputBinaryName,
-	    const std::vector<std::string>& inputFiles, const std::string&,
+	    const std::vector<Path>& inputFiles, const std::string&,
 	    const Target* target) override;
 
 	virtual std::vector<std::string> outputFiles() override;
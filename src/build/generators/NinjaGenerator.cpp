@@ -4,23 +4,61 @@
  */
 #include "NinjaGenerator.h"
 
+#include <set>
+
 #include "Phoenix.h"
 
+#include "script/Object.h"
+
 #include "util/FSUtil.h"
 #include "util/StringUtil.h"
 #include "util/PrintUtil.h"
 #include "util/OSUtil.h"
+#include "util/TraceUtil.h"
 
 using std::string;
 using std::vector;
 
+// Where the source globs get written to, for `phoenix --check-globs`.
+static const char* kGlobsFile = "phoenix.globs";
+// Where the rules go, which every target's file can use (if split.)
+static const char* kRulesFile = "rules.ninja";
+
+static const char* kNinjaGenerator_header =
+	"# This file was automatically generated by Phoenix " PHOENIX_VERSION "\n"
+	"# ALL CHANGES WILL BE LOST ON NEXT REGENERATION!\n";
+
+static const StringUtil::Escaper kNinjaGenerator_escaper({{'$', "$$"}, {':', "$:"},
+	{' ', "$ "}});
+
+// Escapes a path, which Ninja can't have newlines in at all ("$\n" is a line
+// continuation, and would silently name some other file.)
+static string NinjaGenerator_path(const string& path)
+{
+	if (path.find('\n') != string::npos) {
+		throw Script::Exception(Script::Exception::UserError,
+			"Ninja does not support paths containing newlines, such as '" + path + "'");
+	}
+	return kNinjaGenerator_escaper(path);
+}
+
+bool NinjaGenerator::sSplitTargets = false;
+
 NinjaGenerator::NinjaGenerator()
 	:
-	fFeaturePoolConsole(false)
+	fFeaturePoolConsole(false),
+	fDepsPrefixSet(false),
+	fManifest(nullptr),
+	fRules(nullptr)
 {
 }
 NinjaGenerator::~NinjaGenerator()
 {
+	// (If write() wasn't reached, this leaves the old files in place.)
+	delete fManifest;
+	delete fRules;
+	for (FSUtil::AtomicWriter* manifest : fTargetManifests)
+		delete manifest;
 }
 
 bool NinjaGenerator::check()
@@ -55,48 +93,103 @@ bool NinjaGenerator::check()
 	return true;
 }
 
-string NinjaGenerator::escapeString(const string& str)
+void NinjaGenerator::setBuildScriptFiles(const string& program, const vector<string> files)
 {
-	string ret = str;
-	StringUtil::replaceAll(ret, ":", "$:");
-	StringUtil::replaceAll(ret, " ", "$ ");
-	return ret;
+	fRerunProgram = program;
+	fBuildScriptFiles = files;
 }
 
-void NinjaGenerator::setBuildScriptFiles(const string& program, const vector<string> files)
+void NinjaGenerator::setSourceGlobs(const string& phoenix, const vector<Glob>& globs)
 {
-	fRulesLines.push_back("rule RERUN_PHOENIX\n"
-		"  command = " + program + "\n"
+	fCheckGlobsProgram = phoenix;
+	fGlobs = globs;
+}
+
+void NinjaGenerator::_begin()
+{
+	if (fManifest != nullptr)
+		return;
+	if (sSplitTargets) {
+		fRules = new FSUtil::AtomicWriter(kRulesFile);
+		*fRules << string(kNinjaGenerator_header) + "# The rules, included by build.ninja.\n\n";
+	}
+
+	fManifest = new FSUtil::AtomicWriter("build.ninja");
+	*fManifest << kNinjaGenerator_header + string(
+		"ninja_required_version = ") + fRequiredVersion + "\n\n" +
+
+		// Default targets/commands
+		"rule CLEAN\n"
+		"  command = ninja -t clean\n"
+		"  description = Cleaning all built files...\n"
+		"build clean: CLEAN\n\n"
+
+		// Default variables
+		"targetflags = \n\n";
+
+	// Regeneration: when a script changes, or (as the restat on checking the
+	// globs tells) one of the source directories' contents does. This file is
+	// left alone if it comes out the same, hence the restat here too.
+	*fManifest << "rule RERUN_PHOENIX\n"
+		"  command = " + fRerunProgram + "\n"
 		"  description = Re-running Phoenix...\n"
-		"  generator = 1\n" +
-		(fFeaturePoolConsole ? "  pool = console\n" : "")
-		);
+		"  generator = 1\n"
+		"  restat = 1\n" +
+		(fFeaturePoolConsole ? "  pool = console\n" : "") + "\n";
 	string phony = "build"; // So it doesn't error out if a file is missing
 	string build = "build build.ninja: RERUN_PHOENIX |";
-	for (string file : files) {
-		string add = " " + escapeString(file);
+	for (const string& file : fBuildScriptFiles) {
+		const string add = " " + NinjaGenerator_path(file);
 		build += add;
 		phony += add;
 	}
-	phony += ": phony\n";
-	fBuildLines.push_back(build);
-	fBuildLines.push_back(phony);
+	string check;
+	if (!fGlobs.empty()) {
+		*fManifest << "rule CHECK_PHOENIX_GLOBS\n"
+			"  command = " + fCheckGlobsProgram + " --check-globs=$out\n"
+			"  description = Checking for added or removed source files...\n"
+			"  restat = 1\n\n";
+		std::set<string> directories;
+		for (const Glob& glob : fGlobs)
+			directories.insert(glob.directories.begin(), glob.directories.end());
+		check = string("build ") + kGlobsFile + ": CHECK_PHOENIX_GLOBS |";
+		for (const string& directory : directories) {
+			const string add = " " + NinjaGenerator_path(directory);
+			check += add;
+			phony += add;
+		}
+		check += "\n";
+		build += string(" ") + kGlobsFile;
+	}
+	*fManifest << check + build + "\n" + phony + ": phony\n\n";
+	if (sSplitTargets)
+		*fManifest << string("include ") + kRulesFile + "\n\n";
+}
+
+FSUtil::AtomicWriter& NinjaGenerator::_rules()
+{
+	return fRules != nullptr ? *fRules : *fManifest;
+}
+
+static string NinjaGenerator_command(const string& rule)
+{
+	return StringUtil::replaceEach(rule, {{"%INPUTFILE%", "$in"}, {"%OUTPUTFILE%", "$out"},
+		{"%TARGETFLAGS%", "$targetflags"}});
 }
 
 void NinjaGenerator::addRegularRule(const string& ruleName, const string& descName,
 	const vector<string>& forExts, const string& program, const string& outFileExt,
 	DependencyFormat depFormat,	const std::string& depPrefix, const string& rule)
 {
-	if (depFormat == StdoutFormat && !depPrefix.empty() && fDepsPrefix.empty())
-		fDepsPrefix = depPrefix;
-
-	string realRule = rule;
-	StringUtil::replaceAll(realRule, "%INPUTFILE%", "$in");
-	StringUtil::replaceAll(realRule, "%OUTPUTFILE%", "$out");
-	StringUtil::replaceAll(realRule, "%TARGETFLAGS%", "$targetflags");
+	_begin();
+	if (depFormat == StdoutFormat && !depPrefix.empty() && !fDepsPrefixSet) {
+		// (Before any rule that uses it.)
+		_rules() << "msvc_deps_prefix = " + depPrefix + "\n\n";
+		fDepsPrefixSet = true;
+	}
 
 	string ruleLine = "rule " + ruleName + "\n"
-	   "  command = " + program + " " + realRule + "\n"
+	   "  command = " + program + " " + NinjaGenerator_command(rule) + "\n"
 	   "  description = " + descName + " $out\n";
 	if (depFormat == MakeFormat) {
 		ruleLine += "  depfile = $out.d\n"
@@ -104,7 +197,7 @@ void NinjaGenerator::addRegularRule(const string& ruleName, const string& descNa
 	} else if (depFormat == StdoutFormat) {
 		ruleLine += "  deps = msvc\n";
 	}
-	fRulesLines.push_back(ruleLine);
+	_rules() << ruleLine + "\n";
 
 	RuleForExt itm;
 	itm.outFileExt = outFileExt;
@@ -116,46 +209,64 @@ void NinjaGenerator::addRegularRule(const string& ruleName, const string& descNa
 void NinjaGenerator::addLinkRule(const string& ruleName,
 	const string& descName, const string& program, const string& rule)
 {
-	string realRule = rule;
-	StringUtil::replaceAll(realRule, "%INPUTFILE%", "$in");
-	StringUtil::replaceAll(realRule, "%OUTPUTFILE%", "$out");
-	StringUtil::replaceAll(realRule, "%TARGETFLAGS%", "$targetflags");
-	fRulesLines.push_back("rule " + ruleName + "\n"
-		"  command = " + program + " " + realRule + "\n"
-		"  description = " + descName + " $out");
+	_begin();
+	_rules() << "rule " + ruleName + "\n"
+		"  command = " + program + " " + NinjaGenerator_command(rule) + "\n"
+		"  description = " + descName + " $out\n\n";
 }
 
 void NinjaGenerator::addTarget(const string& linkRule, const string& outputBinaryName,
-	const vector<string>& inputFiles, const string& targetFlags, const Target*)
+	const vector<Path>& inputFiles, const string& targetFlags, const Target*)
 {
+	_begin();
+	const string manifestFile = "build-" + outputBinaryName + ".ninja";
+	FSUtil::AtomicWriter* manifest = fManifest;
+	if (sSplitTargets) {
+		manifest = new FSUtil::AtomicWriter(manifestFile);
+		fTargetManifests.push_back(manifest);
+		fTargetManifestFiles.push_back(manifestFile);
+		*manifest << kNinjaGenerator_header + string("\n");
+	}
 	vector<string> outfiles;
-	string targetflagsvar = "tf_" + StringUtil::split(outputBinaryName, ".")[0];
+	string targetflagsvar = "tf_" + outputBinaryName.substr(0, outputBinaryName.find('.'));
 	if (!targetFlags.empty())
-		fBuildLines.push_back(targetflagsvar + " = " + targetFlags);
-	for (string file : inputFiles) {
-		vector<string> splitByDot = StringUtil::split(file, ".");
-		vector<string> splitBySlash = StringUtil::split(file, "/");
-		string ext = "." + splitByDot[splitByDot.size() - 1];
+		*manifest << targetflagsvar + " = " + targetFlags + "\n";
+	string line;
+	for (const Path& file : inputFiles) {
+		const string source = NinjaGenerator_path(file.str());
+		const string name = file.name();
+		const string::size_type dot = name.rfind('.');
+		string ext = "." + (dot == string::npos ? name : name.substr(dot + 1));
 		RuleForExt rule = fRulesForExts[ext];
-		string outFile = "build-" + outputBinaryName + "/" +
-			splitBySlash[splitBySlash.size() - 1] + rule.outFileExt;
+		// (Escaped, as the link line names them too.)
+		const string outFile = NinjaGenerator_path("build-" + outputBinaryName + "/" +
+			name + rule.outFileExt);
 		outfiles.push_back(outFile);
 
-		string line = "build " + escapeString(outFile) + ": " +
-			rule.ruleName + " " + escapeString(file);
+		line = "build " + outFile + ": " + rule.ruleName + " " + source;
 		if (targetflagsvar.length())
 			line += "\n  targetflags = $" + targetflagsvar;
-		fBuildLines.push_back(line);
+		*manifest << line + "\n";
 	}
 	std::string targetFile = /* TODO: runtimeOutputDirectory */ outputBinaryName;
-	fBuildLines.push_back("build " + targetFile + ": " + linkRule +
-		" " + StringUtil::join(outfiles, " ") + "\n");
+	*manifest << "build " + targetFile + ": " + linkRule +
+		" " + StringUtil::join(outfiles, " ") + "\n";
+	if (sSplitTargets) {
+		// (Failures are reported on committing.)
+		manifest->finish();
+		*fManifest << "subninja " + NinjaGenerator_path(manifestFile) + "\n";
+	} else
+		*fManifest << "\n";
 	fTargets.push_back(targetFile);
 }
 
 vector<string> NinjaGenerator::outputFiles()
 {
-	return {"build.ninja"};
+	vector<string> ret = {"build.ninja"};
+	if (sSplitTargets)
+		ret.push_back(kRulesFile);
+	ret.insert(ret.end(), fTargetManifestFiles.begin(), fTargetManifestFiles.end());
+	return ret;
 }
 string NinjaGenerator::command(const string& target)
 {
@@ -164,28 +275,36 @@ string NinjaGenerator::command(const string& target)
 
 void NinjaGenerator::write()
 {
-	FSUtil::setContents("build.ninja",
-		"# This file was automatically generated by Phoenix " PHOENIX_VERSION "\n"
-		"# ALL CHANGES WILL BE LOST ON NEXT REGENERATION!\n"
-		"ninja_required_version = " + fRequiredVersion + "\n\n" +
+	TraceUtil::Span span("write build.ninja", "generator");
+	_begin();
+	// "all" target & target defaults
+	*fManifest << string(sSplitTargets ? "\n" : "") + "build all: phony " +
+		StringUtil::join(fTargets, " ") + "\n" + "default all\n";
+	// (If this fails, checking the globs writes the file anew.)
+	if (!fGlobs.empty() && !Generators::writeGlobs(kGlobsFile, fGlobs))
+		PrintUtil::warning(string("could not write '") + kGlobsFile + "'");
 
-		// Setup stuff
-		(fDepsPrefix.empty() ? "" : "msvc_deps_prefix = " + fDepsPrefix + "\n") +
-
-		// Default targets/commands
-		"rule CLEAN\n"
-		"  command = ninja -t clean\n"
-		"  description = Cleaning all built files...\n"
-		"build clean: CLEAN\n\n"
-
-		// Default variables
-		"targetflags = \n\n" +
-
-		// Actual build stuff
-		StringUtil::join(fRulesLines, "\n") + "\n" +
-		StringUtil::join(fBuildLines, "\n") + "\n" +
-
-		// "all" target & target defaults
-		"build all: phony " + StringUtil::join(fTargets, " ") + "\n" +
-		"default all\n");
+	// What build.ninja includes goes first, so it never refers to what isn't there.
+	bool includedChanged = false;
+	if (fRules != nullptr) {
+		if (!fRules->commit())
+			PrintUtil::warning(string("could not write '") + kRulesFile + "'");
+		includedChanged = fRules->changed();
+	}
+	for (vector<FSUtil::AtomicWriter*>::size_type i = 0; i < fTargetManifests.size(); i++) {
+		if (!fTargetManifests[i]->commit())
+			PrintUtil::warning("could not write '" + fTargetManifestFiles[i] + "'");
+		includedChanged = includedChanged || fTargetManifests[i]->changed();
+		delete fTargetManifests[i];
+	}
+	fTargetManifests.clear();
+	if (!fManifest->commit())
+		PrintUtil::warning("could not write 'build.ninja'");
+	// Ninja only reloads everything if build.ninja itself changes (by restat.)
+	else if (includedChanged && !fManifest->changed())
+		FSUtil::touch("build.ninja");
+	delete fManifest;
+	fManifest = nullptr;
+	delete fRules;
+	fRules = nullptr;
 }
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "build/Generators.h"
+#include "util/FSUtil.h"
 
 class NinjaGenerator : public Generator
 {
@@ -22,6 +23,8 @@ public:
 
 	virtual void setBuildScriptFiles(const std::string& program,
 		const std::vector<std::string> files) override;
+	virtual void setSourceGlobs(const std::string& phoenix,
+		const std::vector<Glob>& globs) override;
 
 	virtual void addRegularRule(const std::string& ruleName,
 		const std::string& descName, const std::vector<std::string>& forExts,
@@ -34,7 +37,7 @@ public:
 
 	virtual void addTarget(const std::string& linkRule,
 	    const std::string& outputBinaryName,
-	    const std::vector<std::string>& inputFiles,
+	    const std::vector<Path>& inputFiles,
 	    const std::string& targetFlags, const Target*) override;
 
 	virtual std::vector<std::string> outputFiles() override;
@@ -42,8 +45,17 @@ public:
 
 	virtual void write() override;
 
+	/*! Whether to write the rules to rules.ninja and each target's build edges
+	 * to a build-<target>.ninja of its own, rather than everything to
+	 * build.ninja (`--split-ninja`.) Then a reconfigure that changes a single
+	 * target rewrites only that target's file, at the cost of a file per target. */
+	static bool sSplitTargets;
+
 private:
-	std::string escapeString(const std::string& str);
+	// Starts writing build.ninja (and rules.ninja), if that hasn't happened yet.
+	void _begin();
+	// Where the rules go.
+	FSUtil::AtomicWriter& _rules();
 
 	std::string fNinjaExecutable;
 	bool fFeaturePoolConsole;
@@ -55,8 +67,18 @@ private:
 	} RuleForExt;
 	std::map<std::string, RuleForExt> fRulesForExts;
 
-	std::string fDepsPrefix;
-	std::vector<std::string> fRulesLines;
-	std::vector<std::string> fBuildLines;
-	std::vector<std::string> fTargets;
+	std::string fRerunProgram;
+	std::vector<std::string> fBuildScriptFiles;
+	std::string fCheckGlobsProgram;
+	std::vector<Glob> fGlobs;
+
+	bool fDepsPrefixSet;
+	/* Rules and build edges are written out as they are added (if split, to
+	 * rules.ninja and each target's file, which build.ninja pulls in with
+	 * `include` and `subninja`), but the files are only committed, together,
+	 * by write(). */
+	FSUtil::AtomicWriter* fManifest;
+	FSUtil::AtomicWriter* fRules;
+	std::vector<FSUtil::AtomicWriter*> fTargetManifests;
+	std::vector<std::string> fTargets, fTargetManifestFiles;
 };
@@ -11,6 +11,7 @@
 #include "build/Target.h"
 #include "build/LanguageInfo.h"
 #include "util/FSUtil.h"
+#include "util/TraceUtil.h"
 
 using std::string;
 using std::vector;
@@ -42,19 +43,19 @@ void QtCreatorGenerator::setBuildScriptFiles(const string&, const vector<string>
 }
 
 void QtCreatorGenerator::addTarget(const string&, const string& outputBinaryName,
-	const vector<string>& inputFiles, const string&, const Target* target)
+	const vector<Path>& inputFiles, const string&, const Target* target)
 {
-	for (const string& file : inputFiles) {
-		if (std::find(fFiles.begin(), fFiles.end(), file) == fFiles.end())
-			fFiles.push_back(file);
+	for (const Path& file : inputFiles) {
+		if (std::find(fFiles.begin(), fFiles.end(), file.str()) == fFiles.end())
+			fFiles.push_back(file.str());
 	}
-	for (const string& file : target->extraFiles) {
-		if (std::find(fFiles.begin(), fFiles.end(), file) == fFiles.end())
-			fFiles.push_back(file);
+	for (const Path& file : target->extraFiles) {
+		if (std::find(fFiles.begin(), fFiles.end(), file.str()) == fFiles.end())
+			fFiles.push_back(file.str());
 	}
-	for (const string& dir : target->includeDirs) {
-		if (std::find(fIncludeDirs.begin(), fIncludeDirs.end(), dir) == fIncludeDirs.end())
-			fIncludeDirs.push_back(dir);
+	for (const Path& dir : target->includeDirs) {
+		if (std::find(fIncludeDirs.begin(), fIncludeDirs.end(), dir.str()) == fIncludeDirs.end())
+			fIncludeDirs.push_back(dir.str());
 	}
 }
 
@@ -69,18 +70,19 @@ vector<string> QtCreatorGenerator::outputFiles()
 }
 void QtCreatorGenerator::write()
 {
+	TraceUtil::Span span("write " + fName + ".creator", "generator");
 	string dotCreator = "[General]\n";
-	FSUtil::setContents(fName + ".creator", dotCreator);
+	FSUtil::setContentsIfChanged(fName + ".creator", dotCreator);
 
-	FSUtil::setContents(fName + ".config", "");
+	FSUtil::setContentsIfChanged(fName + ".config", "");
 
 	string dotFiles;
 	for (const string& file : fFiles)
 		dotFiles.append(file + "\n");
-	FSUtil::setContents(fName + ".files", dotFiles);
+	FSUtil::setContentsIfChanged(fName + ".files", dotFiles);
 
 	string dotIncludes;
 	for (const string& dir : fIncludeDirs)
 		dotIncludes.append(dir + "\n");
-	FSUtil::setContents(fName + ".includes", dotIncludes);
+	FSUtil::setContentsIfChanged(fName + ".includes", dotIncludes);
 }
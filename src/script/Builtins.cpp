@@ -27,17 +27,23 @@ FileBuiltin::FileBuiltin(const string& file)
 {
 	fMap = new ObjectMap;
 
-	fMap->set("exists", FunctionObject([this](Stack*, Object, ObjectMap&) -> Object {
+	fMap->set("exists", FunctionObject([this](Stack* stack, Object, ObjectMap&) -> Object {
+		Recorder::readFile(stack->region(), fFile);
 		return BooleanObject(FSUtil::isFile(fFile));
 	}));
-	fMap->set("setContents", FunctionObject([this](Stack*, Object, ObjectMap& params) -> Object {
+	fMap->set("setContents", FunctionObject([this](Stack* stack, Object, ObjectMap& params) -> Object {
 		NativeFunction_COERCE_OR_THROW("0", zero, Type::String);
-		return BooleanObject(FSUtil::setContents(fFile, zero->string));
+		const string file = fFile, contents = zero->string;
+		stack->defer([file, contents]() { Recorder::output(Recorder::Output::Write, file, contents); });
+		return BooleanObject(FSUtil::setContentsIfChanged(fFile, zero->string));
 	}));
-	fMap->set("getContents", FunctionObject([this](Stack*, Object, ObjectMap&) -> Object {
+	fMap->set("getContents", FunctionObject([this](Stack* stack, Object, ObjectMap&) -> Object {
+		Recorder::readFile(stack->region(), fFile);
 		return StringObject(FSUtil::getContents(fFile));
 	}));
-	fMap->set("remove", FunctionObject([this](Stack*, Object, ObjectMap&) -> Object {
+	fMap->set("remove", FunctionObject([this](Stack* stack, Object, ObjectMap&) -> Object {
+		const string file = fFile;
+		stack->defer([file]() { Recorder::output(Recorder::Output::Remove, file); });
 		return BooleanObject(FSUtil::deleteFile(fFile));
 	}));
 }
@@ -84,14 +90,20 @@ GlobalPhoenixObject::GlobalPhoenixObject(Stack* stack)
 		return MapObject(new ObjectMap(params));
 	})});
 
-	stack->GlobalFunctions.insert({"print", Function([](Stack*, Object, ObjectMap& params) -> Object {
-		Object zero = params.get("0");
-		PrintUtil::message(zero->asStringRaw());
+	stack->GlobalFunctions.insert({"print", Function([](Stack* stack, Object, ObjectMap& params) -> Object {
+		const std::string message = params.get("0")->asStringRaw();
+		stack->defer([message]() {
+			PrintUtil::message(message);
+			Recorder::output(Recorder::Output::Print, message);
+		});
 		return UndefinedObject();
 	})});
-	stack->GlobalFunctions.insert({"dump", Function([](Stack*, Object, ObjectMap& params) -> Object {
-		Object zero = params.get("0");
-		PrintUtil::message(zero->asStringPretty());
+	stack->GlobalFunctions.insert({"dump", Function([](Stack* stack, Object, ObjectMap& params) -> Object {
+		const std::string message = params.get("0")->asStringPretty();
+		stack->defer([message]() {
+			PrintUtil::message(message);
+			Recorder::output(Recorder::Output::Print, message);
+		});
 		return UndefinedObject();
 	})});
 	stack->GlobalFunctions.insert({"fatal", Function([](Stack*, Object, ObjectMap& params) -> Object {
@@ -143,10 +143,10 @@ Object Debugger(Stack* stack, std::string path)
 		}
 	};
 
-	stack->mInterpreterHook = [&](const std::string& path, const std::string& code,
+	stack->mInterpreterHook = [&](const std::string& path, const SourceView& code,
 			const uint32_t line) -> void {
 		runningPath = path;
-		runningCode = code;
+		runningCode = code.str();
 		runningLine = line;
 		DrawCode();
 		DrawStack();
@@ -5,17 +5,18 @@
 #include "script/Function.h"
 
 #include "script/Interpreter.h"
+#include "script/Stack.h"
 
 using std::function;
 using std::string;
 
 namespace Script {
 
-Function::Function(string function, string functionFile, uint32_t functionLine)
+Function::Function(const SourceView& function, string functionFile, uint32_t functionLine)
 	:
 	fIsNull(false),
 	fIsNative(false),
-	fFunction(function),
+	fFunction(function.owned()),
 	fFunctionFile(functionFile),
 	fFunctionLine(functionLine)
 {
@@ -33,8 +34,14 @@ Object Function::call(Stack* stack, Object context, ObjectMap& args)
 	if (fIsNull) {
 		throw Exception(Exception::AccessViolation, "cannot call null function");
 	}
-	if (fIsNative)
+	if (fIsNative) {
+		if (stack->mNativeLock == nullptr)
+			return fNativeFunction(stack, context, args);
+		// Native code is free to touch global state, so on stacks evaluated
+		// in parallel it runs one call at a time.
+		std::lock_guard<std::recursive_mutex> lock(*stack->mNativeLock);
 		return fNativeFunction(stack, context, args);
+	}
 
 	stack->push();
 	if (context != nullptr)
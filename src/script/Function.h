@@ -5,6 +5,7 @@
 #pragma once
 
 #include "Object.h"
+#include "Source.h"
 
 #include <functional>
 #include <string>
@@ -25,19 +26,24 @@ class Function
 {
 public:
 	Function() : fIsNull(true) {}
-	Function(std::string function, std::string functionFile, uint32_t functionLine);
+	// Refers to `function`'s source rather than copying it (unless it's a string.)
+	Function(const SourceView& function, std::string functionFile, uint32_t functionLine);
 	Function(NativeStdFunction nativeFunction);
 
 	Object call(Stack* stack, Object context, ObjectMap& args);
 
 	bool isNative() const { return fIsNative; }
+	// The source of a script function.
+	const SourceView& code() const { return fFunction; }
+	const std::string& file() const { return fFunctionFile; }
+	uint32_t line() const { return fFunctionLine; }
 
 private:
 	bool fIsNull;
 	NativeStdFunction fNativeFunction;
 	bool fIsNative;
 
-	std::string fFunction;
+	SourceView fFunction;
 	std::string fFunctionFile;
 	uint32_t fFunctionLine;
 };
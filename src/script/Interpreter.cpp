@@ -6,10 +6,19 @@
 
 #include "util/FSUtil.h"
 #include "util/StringUtil.h"
+#include "util/TraceUtil.h"
+#include "MemoryProfiler.h"
 #include "Object.h"
+#include "Profiler.h"
+#include "Recorder.h"
 #include "Stack.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <set>
+#include <thread>
 #include <vector>
 
 using std::string;
@@ -94,15 +103,15 @@ Object ExprNode::toObject(Stack* stack)
 #define UNEXPECTED_EOF Exception(Exception::SyntaxError, string("unexpected end of file"))
 #define UNEXPECTED_TOKEN \
 	Exception(Exception::SyntaxError, \
-		string("unexpected token '").append(&code[i], 1).append("'"))
+		string("unexpected token '").append(1, code[i]).append("'"))
 #define UNEXPECTED_TOKEN_EXPECTED(THING) \
 	Exception(Exception::SyntaxError, \
-		string("unexpected token '").append(&code[i], 1).append("' (expected '" THING "')"))
+		string("unexpected token '").append(1, code[i]).append("' (expected '" THING "')"))
 
-Object ParseAndEvalExpression(Stack* stack, const string& code, uint32_t& line, string::size_type& i);
+Object ParseAndEvalExpression(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i);
 
 // Returns whether or not it ignored whitespace
-bool IgnoreWhitespace(Stack*, const string& code, uint32_t& line, string::size_type& i,
+bool IgnoreWhitespace(Stack*, const SourceView& code, uint32_t& line, string::size_type& i,
 	bool ignoreComments = true)
 {
 	const string::size_type oldi = i;
@@ -131,7 +140,7 @@ bool IgnoreWhitespace(Stack*, const string& code, uint32_t& line, string::size_t
 	return oldi < i;
 }
 
-ExprNode EvalVariableName(Stack* stack, const string& code, uint32_t& line, string::size_type& i)
+ExprNode EvalVariableName(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i)
 {
 	assert(code[i] == '$');
 	i++;
@@ -202,7 +211,7 @@ ExprNode EvalVariableName(Stack* stack, const string& code, uint32_t& line, stri
 	return ret;
 }
 
-ExprNode ParseString(Stack*, const string& code, uint32_t& line, string::size_type& i)
+ExprNode ParseString(Stack*, const SourceView& code, uint32_t& line, string::size_type& i)
 {
 	string ret = "";
 	const char endChar = code[i];
@@ -245,7 +254,7 @@ ExprNode ParseString(Stack*, const string& code, uint32_t& line, string::size_ty
 	return ExprNode(ExprNode::Literal, StringObject(ret));
 }
 
-Object ParseNumber(Stack*, const string& code, uint32_t&, string::size_type& i)
+Object ParseNumber(Stack*, const SourceView& code, uint32_t&, string::size_type& i)
 {
 	string number = "";
 	bool atEnd = false;
@@ -273,7 +282,7 @@ Object ParseNumber(Stack*, const string& code, uint32_t&, string::size_type& i)
 	return IntegerObject(ret);
 }
 
-Object ParseCallAndEval(Stack* stack, const string& code, uint32_t& line, string::size_type& i,
+Object ParseCallAndEval(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i,
 	const vector<string>& funcRef, bool variable = false)
 {
 	Function func;
@@ -385,10 +394,13 @@ Object ParseCallAndEval(Stack* stack, const string& code, uint32_t& line, string
 		parentRef.pop_back();
 		context = stack->get_ptr(parentRef);
 	}
+	Profiler::Scope profile(stack->mProfiler);
+	if (stack->mProfiler)
+		profile.enter(stack->mProfiler->call(func, funcRef, variable));
 	return func.call(stack, context, arguments);
 }
 
-Object ParseList(Stack* stack, const string& code, uint32_t& line, string::size_type& i)
+Object ParseList(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i)
 {
 	assert(code[i] == '[');
 	i++;
@@ -439,11 +451,11 @@ public:
 	virtual const char* what() const noexcept { return "Continue"; }
 };
 
-string::size_type LocateEndOfScope(Stack*, const string& code, uint32_t&, const string::size_type& i)
+string::size_type LocateEndOfScope(Stack*, const SourceView& code, uint32_t&, const string::size_type& i)
 {
 	string scope;
 	if (code[i] == '{' || code[i] == '(')
-		scope.append(&code[i], 1);
+		scope.append(1, code[i]);
 	else
 		scope = "_"; // Must be a one-liner
 	string::size_type ret = i;
@@ -485,7 +497,7 @@ string::size_type LocateEndOfScope(Stack*, const string& code, uint32_t&, const
 	}
 	return ret;
 }
-inline void JumpToPosition(const string::size_type& pos, Stack*, const string& code, uint32_t& line,
+inline void JumpToPosition(const string::size_type& pos, Stack*, const SourceView& code, uint32_t& line,
 	string::size_type& i)
 {
 	while (i < pos) {
@@ -496,7 +508,7 @@ inline void JumpToPosition(const string::size_type& pos, Stack*, const string& c
 }
 
 void ConditionalBranchHandler(vector<ExprNode> expression, string thing, Stack* stack,
-	const string& code, uint32_t& line, string::size_type& i)
+	const SourceView& code, uint32_t& line, string::size_type& i)
 {
 	if (expression.size() != 0)
 		throw Exception(Exception::SyntaxError, string("incorrectly placed '").append(thing).append("'"));
@@ -565,17 +577,17 @@ void ConditionalBranchHandler(vector<ExprNode> expression, string thing, Stack*
 			if (code[i] == ';' || code[i] == '}')
 				i++;
 			IgnoreWhitespace(PARSER_PARAMS);
-			if (code.substr(i, 4) == "else") {
+			if (code.compare(i, 4, "else") == 0) {
 				i += 4;
 				IgnoreWhitespace(PARSER_PARAMS);
-				if (code.substr(i, 2) == "if" && !didExec) {
+				if (code.compare(i, 2, "if") == 0 && !didExec) {
 					i += 2;
 					continue;
 				} else if (!didExec) {
 					didExec = CBH_Inner(true);
 					continue;
 				} else {
-					if (code.substr(i, 2) == "if") {
+					if (code.compare(i, 2, "if") == 0) {
 						i += 2;
 						IgnoreWhitespace(PARSER_PARAMS);
 						JumpToPosition(LocateEndOfScope(PARSER_PARAMS), PARSER_PARAMS);
@@ -593,7 +605,58 @@ void ConditionalBranchHandler(vector<ExprNode> expression, string thing, Stack*
 	}
 }
 
-Object ParseAndEvalExpression(Stack* stack, const string& code, uint32_t& line, string::size_type& i)
+static string ScriptFile(string path)
+{
+	if (FSUtil::isFile(path))
+		return path;
+	if (FSUtil::isFile(path = FSUtil::combinePaths({path, "Phoenixfile.phnx"})))
+		return path;
+	return "";
+}
+
+// Evaluates a subdirectory as a Recorder region of its own.
+static Object RunSubdirectory(Stack* stack, const string& path)
+{
+	if (!Recorder::active())
+		return Run(stack, path);
+	Recorder::enter(stack, path, ScriptFile(path));
+	Object ret = Run(stack, path);
+	Recorder::leave(stack, ret);
+	return ret;
+}
+
+// Extends `paths` with the subdirectories named by the statements directly
+// following this one, as long as they are plain `subdirectory "<dir>";`s too.
+// Leaves `i` at the end of the last path consumed, so only the ';' of the last
+// statement is left for the caller.
+void CollectSubdirectories(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i,
+	vector<string>& paths)
+{
+	const string keyword = "subdirectory";
+	while (true) {
+		uint32_t nextLine = line;
+		string::size_type next = i + 1;
+		IgnoreWhitespace(stack, code, nextLine, next);
+		if (next >= code.length() || code[next] != ';')
+			return;
+		next++;
+		IgnoreWhitespace(stack, code, nextLine, next);
+		if (code.compare(next, keyword.length(), keyword) != 0)
+			return;
+		next += keyword.length();
+		if (!IgnoreWhitespace(stack, code, nextLine, next) || next >= code.length() ||
+				(code[next] != '"' && code[next] != '\''))
+			return;
+		ExprNode path = ParseString(stack, code, nextLine, next);
+		if (path.type != ExprNode::Literal)
+			return;
+		paths.push_back(FSUtil::combinePaths({stack->currentDir(), path.literal->string}));
+		line = nextLine;
+		i = next;
+	}
+}
+
+Object ParseAndEvalExpression(Stack* stack, const SourceView& code, uint32_t& line, string::size_type& i)
 {
 	// Parse
 	vector<ExprNode> expression;
@@ -696,17 +759,19 @@ Object ParseAndEvalExpression(Stack* stack, const string& code, uint32_t& line,
 
 				string::size_type funcEnd = LocateEndOfScope(PARSER_PARAMS);
 				i++;
-				string func = code.substr(i, funcEnd - i);
-				expression.push_back(ExprNode(ExprNode::Literal,
-					FunctionObject(new Function(func, stack->currentInputFile(), line))));
-				i = funcEnd;
+				expression.push_back(ExprNode(ExprNode::Literal, FunctionObject(
+					new Function(code.view(i, funcEnd - i), stack->currentInputFile(), line))));
+				JumpToPosition(funcEnd, PARSER_PARAMS);
 			} else if (thing == "subdirectory") {
 				i++;
 				IgnoreWhitespace(PARSER_PARAMS);
 				if (code[i] == '"' || code[i] == '\'') {
 					string path = ParseString(PARSER_PARAMS).toObject(stack)->asStringRaw();
+					vector<string> paths = {FSUtil::combinePaths({stack->currentDir(), path})};
+					if (stack->mParallelJobs > 1 && expression.empty())
+						CollectSubdirectories(PARSER_PARAMS, paths);
 					expression.push_back(ExprNode(ExprNode::Literal,
-						Run(stack, FSUtil::combinePaths({stack->currentDir(), path}))));
+						paths.size() > 1 ? RunParallel(stack, paths) : RunSubdirectory(stack, paths[0])));
 				}
 			} else { // This better be a function call
 				i++;
@@ -926,7 +991,43 @@ Object ParseAndEvalExpression(Stack* stack, const string& code, uint32_t& line,
 #undef RETURN
 }
 
-Object EvalString(Stack* stack, const string& code, string fromPath, const uint32_t fromLine, bool popDirs)
+// Statement hook policies for EvalStatements. EvalString picks one once per
+// call, so when nothing is attached the statement loop has no hooks in it.
+struct NoStatementHooks
+{
+	inline NoStatementHooks(Stack*, const string&, const SourceView&, uint32_t) {}
+};
+struct StatementHooks
+{
+	inline StatementHooks(Stack* stack, const string& path, const SourceView& code, uint32_t line)
+		:
+		fProfile(stack->mProfiler),
+		fSite(path, line)
+	{
+		if (stack->mInterpreterHook)
+			stack->mInterpreterHook(path, code, line);
+		if (stack->mProfiler)
+			fProfile.enter(stack->mProfiler->statement(path, line));
+	}
+
+	Profiler::Scope fProfile;
+	MemoryProfiler::Site fSite;
+};
+
+template<class Hooks>
+void EvalStatements(Stack* stack, const SourceView& code, const string& fromPath, uint32_t& line,
+	string::size_type& i)
+{
+	IgnoreWhitespace(PARSER_PARAMS);
+	while (i < code.length()) {
+		Hooks hooks(stack, fromPath, code, line);
+		ParseAndEvalExpression(PARSER_PARAMS);
+		i++;
+		IgnoreWhitespace(PARSER_PARAMS);
+	}
+}
+
+Object EvalString(Stack* stack, const SourceView& code, string fromPath, const uint32_t fromLine, bool popDirs)
 {
 	uint32_t line = fromLine;
 	string::size_type i = 0;
@@ -934,14 +1035,10 @@ Object EvalString(Stack* stack, const string& code, string fromPath, const uint3
 		i += 3;
 	}
 	try {
-		IgnoreWhitespace(PARSER_PARAMS);
-		while (i < code.length()) {
-			if (stack->mInterpreterHook)
-				stack->mInterpreterHook(fromPath, code, line);
-			ParseAndEvalExpression(PARSER_PARAMS);
-			i++;
-			IgnoreWhitespace(PARSER_PARAMS);
-		}
+		if (stack->instrumented())
+			EvalStatements<StatementHooks>(stack, code, fromPath, line, i);
+		else
+			EvalStatements<NoStatementHooks>(stack, code, fromPath, line, i);
 	} catch (ReturnValue& e) {
 		if (popDirs)
 			stack->popDir();
@@ -970,18 +1067,141 @@ Object EvalString(Stack* stack, const string& code, string fromPath, const uint3
 
 Object Run(Stack* stack, string path)
 {
-	string filename;
-	if (FSUtil::isFile(path))
-		filename = path;
-	else if (FSUtil::isFile(path = FSUtil::combinePaths({path, "Phoenixfile.phnx"})))
-		filename = path;
+	string filename = ScriptFile(path);
 	if (filename.empty())
-		throw Exception(Exception::FileDoesNotExist, path);
-	string code = FSUtil::getContents(filename);
+		throw Exception(Exception::FileDoesNotExist, FSUtil::combinePaths({path, "Phoenixfile.phnx"}));
+	TraceUtil::Span span(filename, "script");
+	const SourceView code(Source::fromFile(filename));
 	stack->pushDir(FSUtil::parentDirectory(filename));
 	stack->appendInputFile(filename);
 
 	return EvalString(stack, code, filename, 1, true);
 }
 
+// Whether a subdirectory script computes the same things on a child stack as
+// it would on the shared one: it must not evaluate subdirectories itself, read
+// superglobals native code may still change, or use variables from outside
+// other than by reading their value. `inherited` gets the ones it reads.
+// (Script functions from outside are not just read: their bodies, which this
+// doesn't see, could use anything.)
+static bool IsIsolated(Stack* stack, const SourceView& code, std::set<string>& inherited)
+{
+	if (code.find("subdirectory") != string::npos)
+		return false;
+
+	std::set<string> seen;
+	for (string::size_type i = 0; i < code.length(); i++) {
+		if (code[i] != '$')
+			continue;
+		const bool superglobal = (i + 1 < code.length() && code[i + 1] == '$');
+		string::size_type end = i + (superglobal ? 2 : 1);
+		while (end < code.length() && (isalnum((unsigned char)code[end]) || code[end] == '_'))
+			end++;
+		const string name = code.substr(i + (superglobal ? 2 : 1), end - i - (superglobal ? 2 : 1));
+		i = end - 1;
+		if (name.empty())
+			continue;
+		if (superglobal) {
+			if (stack->isVolatileSuperglobal(name))
+				return false;
+			continue;
+		}
+
+		while (end < code.length() && (code[end] == ' ' || code[end] == '\t'))
+			end++;
+		const char c0 = (end < code.length()) ? code[end] : '\0',
+			c1 = (end + 1 < code.length()) ? code[end + 1] : '\0';
+		const bool assigns = (c0 == '=' && c1 != '=');
+		const bool modifies = assigns || (c1 == '=' && strchr("+-*/%", c0) != nullptr) ||
+			(c0 == c1 && (c0 == '+' || c0 == '-'));
+
+		if (inherited.count(name) != 0 ||
+				(seen.count(name) == 0 && stack->defined(name))) {
+			// Members are conservatively treated as writes, as a method call
+			// could modify the original.
+			if (modifies || c0 == '.' || c0 == '[')
+				return false;
+			const Object value = stack->peek(name);
+			if (value->type() == Type::Function && !value->function->isNative())
+				return false;
+			inherited.insert(name);
+		} else if (seen.count(name) == 0 && !assigns) {
+			// Read before being assigned: it might come from a sibling.
+			return false;
+		}
+		seen.insert(name);
+	}
+	return true;
+}
+
+Object RunParallel(Stack* stack, const vector<string>& paths)
+{
+	bool parallel = stack->mParallelJobs > 1 && !stack->instrumented();
+	vector<std::set<string> > inherited(paths.size());
+	for (vector<string>::size_type k = 0; parallel && k < paths.size(); k++) {
+		const string filename = ScriptFile(paths[k]);
+		parallel = !filename.empty() && IsIsolated(stack, Source::fromFile(filename), inherited[k]);
+	}
+	if (!parallel) {
+		Object ret;
+		for (const string& path : paths)
+			ret = RunSubdirectory(stack, path);
+		return ret;
+	}
+
+	// Each child is a region of its own, which is left open until it is joined.
+	std::recursive_mutex nativeLock;
+	vector<Stack*> children;
+	vector<int32_t> regions;
+	for (vector<string>::size_type k = 0; k < paths.size(); k++) {
+		regions.push_back(Recorder::enter(stack, paths[k], ScriptFile(paths[k])));
+		children.push_back(stack->createChild(inherited[k], &nativeLock));
+		Recorder::suspend();
+	}
+	vector<Object> results(paths.size());
+	vector<std::exception_ptr> errors(paths.size());
+
+	std::atomic<size_t> next(0);
+	std::function<void()> worker = [&]() {
+		// Each worker's scripts show up on a track of their own.
+		const int previousTrack = TraceUtil::currentTrack();
+		const int track = TraceUtil::acquireTrack();
+		TraceUtil::setCurrentTrack(track);
+		for (size_t k; (k = next++) < paths.size(); ) {
+			try {
+				results[k] = Run(children[k], paths[k]);
+			} catch (...) {
+				errors[k] = std::current_exception();
+			}
+		}
+		TraceUtil::releaseTrack(track);
+		TraceUtil::setCurrentTrack(previousTrack);
+	};
+	vector<std::thread> threads;
+	try {
+		for (size_t t = 1; t < std::min<size_t>(stack->mParallelJobs, paths.size()); t++)
+			threads.push_back(std::thread(worker));
+	} catch (const std::system_error&) {
+		// No (more) threads available; make do with what we have.
+	}
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// Merge in declaration order, up to and including the first failure,
+	// just as far as serial evaluation would have gotten.
+	std::exception_ptr error;
+	for (vector<Stack*>::size_type k = 0; k < children.size() && !error; k++) {
+		Recorder::resume(stack, regions[k]);
+		stack->joinChild(children[k]);
+		Recorder::leave(stack, results[k]);
+		error = errors[k];
+	}
+	for (Stack* child : children)
+		delete child;
+	if (error)
+		std::rethrow_exception(error);
+	return results.back();
+}
+
 }
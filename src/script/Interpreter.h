@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "Object.h"
+#include "Source.h"
 #include "Stack.h"
 
 namespace Script {
@@ -39,9 +40,13 @@ public:
 	std::vector<std::string> variable;
 };
 
-ExprNode EvalVariableName(Stack* stack, const std::string& code, uint32_t& line, std::string::size_type& i);
-Object EvalString(Stack* stack, const std::string& code, std::string fromPath, const uint32_t fromLine = 1,
+ExprNode EvalVariableName(Stack* stack, const SourceView& code, uint32_t& line, std::string::size_type& i);
+Object EvalString(Stack* stack, const SourceView& code, std::string fromPath, const uint32_t fromLine = 1,
 	bool popDirs = false);
 Object Run(Stack* stack, std::string path);
+// Evaluates the subdirectories concurrently, each on a child stack, if
+// parallel evaluation is enabled and none of them depends on another;
+// otherwise evaluates them in order, as Run does.
+Object RunParallel(Stack* stack, const std::vector<std::string>& paths);
 
 }
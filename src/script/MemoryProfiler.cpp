@@ -0,0 +1,194 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "script/MemoryProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "script/Object.h"
+#include "script/Stack.h"
+#include "util/FSUtil.h"
+
+using std::string;
+using std::vector;
+
+namespace Script {
+
+MemoryProfiler* MemoryProfiler::sActive = nullptr;
+
+MemoryProfiler::MemoryProfiler()
+	:
+	fSite(0),
+	fLiveBytes(0),
+	fPeakBytes(0)
+{
+	// Anything made outside of a script statement (builtins, arguments
+	// passed in from C++) is attributed to this site.
+	fSiteNames.push_back("<native>");
+	sActive = this;
+}
+
+MemoryProfiler::~MemoryProfiler()
+{
+	if (sActive == this)
+		sActive = nullptr;
+}
+
+int32_t MemoryProfiler::_site(const string& file, uint32_t line)
+{
+	std::pair<std::map<std::pair<string, uint32_t>, int32_t>::iterator, bool> result =
+		fSiteIds.insert({{file, line}, (int32_t)fSiteNames.size()});
+	if (result.second)
+		fSiteNames.push_back(file + ":" + std::to_string(line));
+	return result.first->second;
+}
+
+void MemoryProfiler::_allocated(const void* ptr, Kind kind, size_t bytes)
+{
+	// Should an address be reported twice without being freed in between,
+	// only count the newer allocation.
+	_freed(ptr);
+
+	Totals& totals = fTotals[{fSite, kind}];
+	totals.liveBytes += bytes;
+	totals.liveCount++;
+	totals.totalBytes += bytes;
+	totals.totalCount++;
+	fLive[ptr] = {&totals, fSite, bytes};
+
+	fLiveBytes += bytes;
+	fPeakBytes = std::max(fPeakBytes, fLiveBytes);
+}
+
+void MemoryProfiler::_resized(const void* ptr, size_t bytes)
+{
+	std::unordered_map<const void*, Record>::iterator it = fLive.find(ptr);
+	if (it == fLive.end() || it->second.bytes == bytes)
+		return;
+	Record& record = it->second;
+	if (bytes > record.bytes) {
+		record.totals->liveBytes += bytes - record.bytes;
+		record.totals->totalBytes += bytes - record.bytes;
+		fLiveBytes += bytes - record.bytes;
+		fPeakBytes = std::max(fPeakBytes, fLiveBytes);
+	} else {
+		record.totals->liveBytes -= record.bytes - bytes;
+		fLiveBytes -= record.bytes - bytes;
+	}
+	record.bytes = bytes;
+}
+
+void MemoryProfiler::_freed(const void* ptr)
+{
+	std::unordered_map<const void*, Record>::iterator it = fLive.find(ptr);
+	if (it == fLive.end())
+		return;
+	it->second.totals->liveBytes -= it->second.bytes;
+	it->second.totals->liveCount--;
+	fLiveBytes -= it->second.bytes;
+	fLive.erase(it);
+}
+
+struct MemoryProfiler::Reachable {
+	string path;
+	int32_t site;
+	size_t elements;
+	uint64_t bytes;
+};
+
+uint64_t MemoryProfiler::_walk(const Object& object, const string& path,
+	vector<Reachable>& lists, vector<Reachable>& maps)
+{
+	if (object == nullptr)
+		return 0;
+	std::unordered_map<const void*, Record>::const_iterator record = fLive.find(object.get());
+	uint64_t bytes = (record != fLive.end()) ? record->second.bytes : 0;
+
+	if (object->list != nullptr) {
+		record = fLive.find(object->list);
+		Reachable found = {path, 0, object->list->size(), 0};
+		if (record != fLive.end()) {
+			found.site = record->second.site;
+			found.bytes = record->second.bytes;
+		}
+		for (ObjectList::size_type i = 0; i < object->list->size(); i++) {
+			found.bytes += _walk(object->list->get_ptr(i),
+				path + "[" + std::to_string(i) + "]", lists, maps);
+		}
+		lists.push_back(found);
+		bytes += found.bytes;
+	} else if (object->map != nullptr) {
+		record = fLive.find(object->map);
+		Reachable found = {path, 0, object->map->size(), 0};
+		if (record != fLive.end()) {
+			found.site = record->second.site;
+			found.bytes = record->second.bytes;
+		}
+		for (ObjectMap::const_iterator it = object->map->begin(); it != object->map->end(); it++)
+			found.bytes += _walk(it->second, path + "." + it->first, lists, maps);
+		maps.push_back(found);
+		bytes += found.bytes;
+	}
+	return bytes;
+}
+
+bool MemoryProfiler::write(const string& file, Stack* stack)
+{
+	static const char* kinds[] = {"object", "copy", "list", "map"};
+	char buf[128];
+
+	string report = "Phoenix script memory profile (sizes in KiB)\n";
+	snprintf(buf, sizeof(buf), "\nlive at exit: %.1f, peak: %.1f\n",
+		fLiveBytes / 1024.0, fPeakBytes / 1024.0);
+	report += buf;
+
+	typedef std::pair<std::pair<int32_t, Kind>, Totals> Item;
+	vector<Item> items(fTotals.begin(), fTotals.end());
+	std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+		if (a.second.liveBytes != b.second.liveBytes)
+			return a.second.liveBytes > b.second.liveBytes;
+		return a.second.totalBytes > b.second.totalBytes;
+	});
+	report += "\nSites:\n"
+		"  live size   live count   total size  total count  kind    location\n";
+	for (const Item& item : items) {
+		snprintf(buf, sizeof(buf), "%11.1f %12llu %12.1f %12llu  %-6s  ",
+			item.second.liveBytes / 1024.0, (unsigned long long)item.second.liveCount,
+			item.second.totalBytes / 1024.0, (unsigned long long)item.second.totalCount,
+			kinds[item.first.second]);
+		report += buf + fSiteNames[item.first.first] + "\n";
+	}
+
+	// Find the largest containers still reachable from a variable.
+	vector<Reachable> lists, maps;
+	for (const ObjectMap& scope : stack->get()) {
+		for (ObjectMap::const_iterator it = scope.begin(); it != scope.end(); it++)
+			_walk(it->second, "$" + it->first, lists, maps);
+	}
+
+	const vector<Reachable>::size_type kLargest = 10;
+	std::pair<const char*, vector<Reachable>*> containers[] = {
+		{"Largest reachable lists", &lists}, {"Largest reachable maps", &maps}};
+	for (const std::pair<const char*, vector<Reachable>*>& kind : containers) {
+		vector<Reachable>& found = *kind.second;
+		std::stable_sort(found.begin(), found.end(), [](const Reachable& a, const Reachable& b) {
+			return a.bytes > b.bytes;
+		});
+		if (found.size() > kLargest)
+			found.resize(kLargest);
+
+		report += string("\n") + kind.first + ":\n"
+			"       size     elements  variable (allocated at)\n";
+		for (const Reachable& container : found) {
+			snprintf(buf, sizeof(buf), "%11.1f %12llu  ", container.bytes / 1024.0,
+				(unsigned long long)container.elements);
+			report += buf + container.path + " (" + fSiteNames[container.site] + ")\n";
+		}
+	}
+
+	return FSUtil::setContents(file, report);
+}
+
+}
@@ -0,0 +1,97 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Script {
+
+// Predefinitions
+class CObject;
+class Stack;
+
+/*! Attributes every CObject, ObjectList, ObjectMap and deep copy to the script
+ * file and line that was executing when it was made. Only one profiler can be
+ * active at a time; while none is, the hooks are a single null check.
+ *
+ * Byte counts are estimates of the heap each value owns (the object itself,
+ * its string or its container storage), not of what the allocator used. */
+class MemoryProfiler
+{
+public:
+	enum Kind {
+		Value = 0,
+		Copy,
+		List,
+		Map,
+	};
+
+	MemoryProfiler();
+	~MemoryProfiler();
+
+	static inline bool active() { return sActive != nullptr; }
+	static inline void allocated(const void* ptr, Kind kind, size_t bytes)
+		{ if (sActive) sActive->_allocated(ptr, kind, bytes); }
+	static inline void resized(const void* ptr, size_t bytes)
+		{ if (sActive) sActive->_resized(ptr, bytes); }
+	static inline void freed(const void* ptr)
+		{ if (sActive) sActive->_freed(ptr); }
+
+	// Writes a report of live and total bytes per site, and of the largest
+	// lists and maps still reachable from the stack.
+	bool write(const std::string& file, Stack* stack);
+
+	// Attributes allocations to a line while it is in scope.
+	class Site
+	{
+	public:
+		inline Site(const std::string& file, uint32_t line) : fPrevious(-1)
+			{ if (sActive) { fPrevious = sActive->fSite; sActive->fSite = sActive->_site(file, line); } }
+		inline ~Site() { if (sActive && fPrevious >= 0) sActive->fSite = fPrevious; }
+
+	private:
+		int32_t fPrevious;
+	};
+
+private:
+	struct Reachable;
+
+	void _allocated(const void* ptr, Kind kind, size_t bytes);
+	void _resized(const void* ptr, size_t bytes);
+	void _freed(const void* ptr);
+	int32_t _site(const std::string& file, uint32_t line);
+	uint64_t _walk(const std::shared_ptr<CObject>& object, const std::string& path,
+		std::vector<Reachable>& lists, std::vector<Reachable>& maps);
+
+	struct Totals {
+		Totals() : liveBytes(0), liveCount(0), totalBytes(0), totalCount(0) {}
+		uint64_t liveBytes;
+		uint64_t liveCount;
+		uint64_t totalBytes;
+		uint64_t totalCount;
+	};
+	struct Record {
+		Totals* totals;
+		int32_t site;
+		size_t bytes;
+	};
+
+	static MemoryProfiler* sActive;
+
+	int32_t fSite;
+	std::vector<std::string> fSiteNames;
+	std::map<std::pair<std::string, uint32_t>, int32_t> fSiteIds;
+	std::map<std::pair<int32_t, Kind>, Totals> fTotals;
+	std::unordered_map<const void*, Record> fLive;
+	uint64_t fLiveBytes;
+	uint64_t fPeakBytes;
+};
+
+}
@@ -50,6 +50,7 @@ CObject::CObject(const Type type)
 
 	fType(type)
 {
+	MemoryProfiler::allocated(this, MemoryProfiler::Value, bytes());
 }
 CObject::CObject(const CObject& other)
 	:
@@ -64,6 +65,7 @@ CObject::CObject(const CObject& other)
 	if (other.function) function = new Function(*other.function);
 	else if (other.list) list = new ObjectList(*other.list);
 	else if (other.map) map = new ObjectMap(*other.map);
+	MemoryProfiler::allocated(this, MemoryProfiler::Copy, bytes());
 }
 CObject& CObject::operator=(const CObject& other)
 {
@@ -78,12 +80,14 @@ CObject& CObject::operator=(const CObject& other)
 	if (other.function) function = new Function(*other.function);
 	else if (other.list) list = new ObjectList(*other.list);
 	else if (other.map) map = new ObjectMap(*other.map);
+	MemoryProfiler::resized(this, bytes());
 
 	return *this;
 }
 
 CObject::~CObject()
 {
+	MemoryProfiler::freed(this);
 	delete function;
 	delete list;
 	delete map;
@@ -310,6 +314,7 @@ ObjectList::ObjectList(const ObjectList& other)
 	:
 	_inherited()
 {
+	MemoryProfiler::allocated(this, MemoryProfiler::List, bytes());
 	for (const_iterator it = other.begin(); it != other.end(); it++)
 		push_back(CopyObject(*it));
 }
@@ -318,6 +323,7 @@ ObjectList& ObjectList::operator=(const ObjectList& other)
 	clear();
 	for (const_iterator it = other.begin(); it != other.end(); it++)
 		push_back(CopyObject(*it));
+	MemoryProfiler::resized(this, bytes());
 	return *this;
 }
 
@@ -331,6 +337,7 @@ void ObjectList::set_ptr(_inherited::size_type i, const Object obj)
 		}
 	}
 	_inherited::operator[](i) = obj;
+	MemoryProfiler::resized(this, bytes());
 }
 
 }
@@ -10,6 +10,8 @@
 #include <vector>
 #include <memory>
 
+#include "MemoryProfiler.h"
+
 namespace Script {
 
 // Predefinitions
@@ -70,6 +72,8 @@ public:
 	std::string typeName() const;
 	std::string asStringPretty() const;
 	std::string asStringRaw() const;
+	// An estimate of the memory this object itself owns (not its list or map.)
+	inline size_t bytes() const { return sizeof(CObject) + string.capacity(); }
 
 	Object primitiveMember(const std::string& member);
 	inline Object get(const char* key) const;
@@ -142,6 +146,7 @@ inline Object StringObject(const std::string& value)
 {
 	Object ret = std::make_shared<CObject>(Type::String);
 	ret->string = std::string(value);
+	MemoryProfiler::resized(ret.get(), ret->bytes());
 	return ret;
 }
 inline Object CopyObject(const Object other)
@@ -170,14 +175,17 @@ public:
 	inline void set(std::string key, Object value) { set_ptr(key, CopyObject(value)); }
 
 	size_type size() const { return _inherited::size(); }
+	// Each entry is a tree node holding the key and the pointer.
+	inline size_t bytes() const { return sizeof(ObjectMap) +
+		size() * (sizeof(value_type) + 4 * sizeof(void*)); }
 };
 
 class ObjectList : private std::vector<Object>
 {
 	typedef std::vector<Object> _inherited;
 public:
-	ObjectList() {}
-	~ObjectList() {}
+	ObjectList() { MemoryProfiler::allocated(this, MemoryProfiler::List, bytes()); }
+	~ObjectList() { MemoryProfiler::freed(this); }
 	// Copy constructors
 	ObjectList(const ObjectList& other);
 	ObjectList& operator=(const ObjectList& other);
@@ -187,7 +195,8 @@ public:
 	const_iterator begin() const { return _inherited::begin(); }
 	const_iterator end() const { return _inherited::end(); }
 
-	void push_back(const Object obj) { _inherited::push_back(CopyObject(obj)); }
+	void push_back(const Object obj) {
+		_inherited::push_back(CopyObject(obj)); MemoryProfiler::resized(this, bytes()); }
 
 	Object get(_inherited::size_type i) { return CopyObject(get_ptr(i)); }
 	Object get_ptr(_inherited::size_type i) { return _inherited::at(i); }
@@ -196,6 +205,7 @@ public:
 	void set_ptr(_inherited::size_type i, const Object obj);
 
 	size_type size() const { return _inherited::size(); }
+	inline size_t bytes() const { return sizeof(ObjectList) + capacity() * sizeof(Object); }
 };
 
 // Must be down here, as it needs ObjectList's definition
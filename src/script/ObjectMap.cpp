@@ -13,9 +13,11 @@ ObjectMap::ObjectMap()
 	:
 	_inherited()
 {
+	MemoryProfiler::allocated(this, MemoryProfiler::Map, bytes());
 }
 ObjectMap::~ObjectMap()
 {
+	MemoryProfiler::freed(this);
 }
 
 ObjectMap::ObjectMap(const ObjectMap& other)
@@ -24,12 +26,14 @@ ObjectMap::ObjectMap(const ObjectMap& other)
 {
 	for (const_iterator it = other.begin(); it != other.end(); it++)
 		insert({it->first, CopyObject(it->second)});
+	MemoryProfiler::allocated(this, MemoryProfiler::Map, bytes());
 }
 ObjectMap& ObjectMap::operator=(const ObjectMap& other)
 {
 	clear();
 	for (const_iterator it = other.begin(); it != other.end(); it++)
 		insert({it->first, CopyObject(it->second)});
+	MemoryProfiler::resized(this, bytes());
 	return *this;
 }
 
@@ -54,8 +58,10 @@ void ObjectMap::set_ptr(string key, Object value)
 	_inherited::iterator it = find(key);
 	if (it != end())
 		it->second = value;
-	else
+	else {
 		insert({key, value});
+		MemoryProfiler::resized(this, bytes());
+	}
 }
 
 }
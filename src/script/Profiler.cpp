@@ -0,0 +1,149 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "script/Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "script/Function.h"
+#include "util/FSUtil.h"
+#include "util/StringUtil.h"
+
+using std::string;
+using std::vector;
+
+namespace Script {
+
+Profiler::Profiler()
+	:
+	fLastLines(nullptr)
+{
+}
+
+int32_t& Profiler::_site(Kind kind, const string& file, uint32_t line)
+{
+	vector<int32_t>* lines;
+	if (kind == Statement && fLastLines != nullptr && file == fLastFile) {
+		lines = fLastLines;
+	} else {
+		lines = &fSites[kind][file];
+		if (kind == Statement) {
+			fLastFile = file;
+			fLastLines = lines;
+		}
+	}
+	if (line >= lines->size())
+		lines->resize(line + 1, -1);
+	return (*lines)[line];
+}
+
+int32_t Profiler::statement(const string& file, uint32_t line)
+{
+	int32_t& entry = _site(Statement, file, line);
+	if (entry < 0) {
+		entry = fEntries.size();
+		fEntries.push_back(Entry(Statement, file + ":" + std::to_string(line)));
+	}
+	return entry;
+}
+
+int32_t Profiler::call(const Function& function, const vector<string>& ref, bool variable)
+{
+	// Script functions by their definition, whatever they were called as
+	// (the first name they were called by is only what the report shows.)
+	int32_t* entry;
+	if (function.isNative()) {
+		const string name = StringUtil::join(ref, ".");
+		entry = &fNatives.insert({name, -1}).first->second;
+		if (*entry < 0) {
+			*entry = fEntries.size();
+			fEntries.push_back(Entry(Call, name));
+		}
+	} else {
+		entry = &_site(Call, function.file(), function.line());
+		if (*entry < 0) {
+			*entry = fEntries.size();
+			fEntries.push_back(Entry(Call, (variable ? "$" : "") + StringUtil::join(ref, ".") +
+				" (" + function.file() + ":" + std::to_string(function.line()) + ")"));
+		}
+	}
+	return *entry;
+}
+
+void Profiler::enter(int32_t entry)
+{
+	Frame frame;
+	frame.entry = entry;
+	fEntries[entry].calls++;
+	fEntries[entry].active++;
+	frame.stackLength = fStack.length();
+	frame.children = 0;
+	if (!fStack.empty())
+		fStack += ';';
+	fStack += fEntries[entry].name;
+	fFrames.push_back(frame);
+	// Start the clock last, so the bookkeeping isn't counted.
+	fFrames.back().start = Clock::now();
+}
+
+void Profiler::exit()
+{
+	const Clock::time_point end = Clock::now();
+	Frame& frame = fFrames.back();
+	const uint64_t inclusive =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - frame.start).count();
+	const uint64_t exclusive = inclusive - std::min(inclusive, frame.children);
+
+	Entry& entry = fEntries[frame.entry];
+	entry.active--;
+	if (entry.active == 0)
+		entry.inclusive += inclusive;
+	entry.exclusive += exclusive;
+	fFolded[fStack] += exclusive;
+
+	fStack.resize(frame.stackLength);
+	fFrames.pop_back();
+	if (!fFrames.empty())
+		fFrames.back().children += inclusive;
+}
+
+bool Profiler::write(const string& prefix)
+{
+	const char* titles[] = {"Statements", "Calls"};
+
+	string report = "Phoenix script profile (times in milliseconds)\n";
+	char buf[64];
+	for (int kind = Statement; kind <= Call; kind++) {
+		vector<const Entry*> items;
+		for (const Entry& entry : fEntries) {
+			if (entry.kind == kind)
+				items.push_back(&entry);
+		}
+		std::stable_sort(items.begin(), items.end(), [](const Entry* a, const Entry* b) {
+			return a->exclusive > b->exclusive;
+		});
+
+		report += string("\n") + titles[kind] + ":\n"
+			"   inclusive    exclusive      calls  location\n";
+		for (const Entry* item : items) {
+			snprintf(buf, sizeof(buf), "%12.3f %12.3f %10llu  ",
+				item->inclusive / 1000000.0, item->exclusive / 1000000.0,
+				(unsigned long long)item->calls);
+			report += buf + item->name + "\n";
+		}
+	}
+
+	string folded;
+	for (std::map<string, uint64_t>::const_iterator it = fFolded.begin();
+		 it != fFolded.end(); it++) {
+		// Microseconds, so the numbers stay manageable.
+		folded += it->first + " " + std::to_string(it->second / 1000) + "\n";
+	}
+
+	bool ok = FSUtil::setContents(prefix + ".txt", report);
+	return FSUtil::setContents(prefix + ".folded", folded) && ok;
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <chrono>
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Script {
+
+// Predefinitions
+class Function;
+
+/*! Collects inclusive/exclusive time and call counts for every statement
+ * (by file and line) and every function call (by where the function was
+ * defined, or by name for native ones) the interpreter runs. */
+class Profiler
+{
+public:
+	enum Kind {
+		Statement = 0,
+		Call,
+	};
+
+	Profiler();
+
+	/*! The entries to enter() for a statement at `line` of `file`, and for a
+	 * call of `function` by the name `ref` (of a variable, if `variable`.)
+	 * These are interned: looking one up again doesn't build its name. */
+	int32_t statement(const std::string& file, uint32_t line);
+	int32_t call(const Function& function, const std::vector<std::string>& ref, bool variable);
+
+	void enter(int32_t entry);
+	void exit();
+
+	// Writes `<prefix>.txt` (a report sorted by exclusive time) and
+	// `<prefix>.folded` (folded stacks, for flamegraph tools.)
+	bool write(const std::string& prefix);
+
+	// Exits the entered frame (if any) when it goes out of scope.
+	class Scope
+	{
+	public:
+		inline Scope(Profiler* profiler) : fProfiler(profiler), fEntered(false) {}
+		inline ~Scope() { if (fEntered) fProfiler->exit(); }
+		inline void enter(int32_t entry)
+			{ fProfiler->enter(entry); fEntered = true; }
+
+	private:
+		Profiler* fProfiler;
+		bool fEntered;
+	};
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry {
+		Entry(Kind kind, const std::string& name)
+			: kind(kind), name(name), inclusive(0), exclusive(0), calls(0), active(0) {}
+		Kind kind;
+		std::string name;
+		uint64_t inclusive; // nanoseconds
+		uint64_t exclusive;
+		uint64_t calls;
+		uint32_t active; // so recursion doesn't count inclusive time twice
+	};
+	struct Frame {
+		int32_t entry;
+		std::string::size_type stackLength;
+		Clock::time_point start;
+		uint64_t children;
+	};
+
+	// The entry for each line of each file (-1 if there is none yet.)
+	int32_t& _site(Kind kind, const std::string& file, uint32_t line);
+
+	std::vector<Entry> fEntries;
+	std::unordered_map<std::string, std::vector<int32_t> > fSites[2];
+	std::unordered_map<std::string, int32_t> fNatives;
+	// Statements come from the same file many times in a row.
+	std::string fLastFile;
+	std::vector<int32_t>* fLastLines;
+	std::map<std::string, uint64_t> fFolded;
+	std::vector<Frame> fFrames;
+	std::string fStack; // the current folded stack
+};
+
+}
@@ -0,0 +1,108 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "script/Recorder.h"
+
+#include "script/Object.h"
+#include "script/Stack.h"
+
+using std::string;
+
+namespace Script {
+
+Recorder* Recorder::sActive = nullptr;
+
+Recorder::Recorder()
+	:
+	fPrevious(sActive),
+	fCurrent(0),
+	fEffects(0)
+{
+	fRegions.push_back(Region());
+	fRegions[0].parent = 0;
+	fRegions[0].standalone = false;
+	fRegions[0].firstInputFile = fRegions[0].inputFiles = 0;
+	fRegions[0].firstEffect = fRegions[0].effects = 0;
+	fRegions[0].firstOutput = fRegions[0].outputs = 0;
+	sActive = this;
+}
+
+Recorder::~Recorder()
+{
+	if (sActive == this)
+		sActive = fPrevious;
+}
+
+int32_t Recorder::_enter(Stack* stack, const string& path, const string& file)
+{
+	Region region;
+	region.path = path;
+	region.file = file;
+	region.directories = stack->directories();
+	region.parent = fCurrent;
+	region.standalone = true;
+	region.firstInputFile = region.inputFiles = 0;
+	region.firstEffect = region.effects = 0;
+	region.firstOutput = region.outputs = 0;
+	fRegions.push_back(region);
+	fCurrent = fRegions.size() - 1;
+	_resume(stack, fCurrent);
+
+	// Inside a function, the script's variables are not where they usually are.
+	if (stack->get().size() > 1)
+		_unrestorable(fCurrent);
+	return fCurrent;
+}
+
+void Recorder::_resume(Stack* stack, int32_t region)
+{
+	fCurrent = region;
+	fRegions[region].firstInputFile = stack->inputFileCount();
+	fRegions[region].firstEffect = fEffects;
+	fRegions[region].firstOutput = fOutputs.size();
+}
+
+void Recorder::_leave(Stack* stack, const std::shared_ptr<CObject>& result)
+{
+	Region& region = fRegions[fCurrent];
+	region.inputFiles = stack->inputFileCount() - region.firstInputFile;
+	region.effects = fEffects - region.firstEffect;
+	region.outputs = fOutputs.size() - region.firstOutput;
+	if (result != nullptr && result->type() != Type::Undefined)
+		region.standalone = false;
+	fCurrent = region.parent;
+}
+
+void Recorder::_read(const string& name, const std::shared_ptr<CObject>& value)
+{
+	std::map<string, int32_t>::const_iterator owner = fOwners.find(name);
+	const int32_t assigner = (owner != fOwners.end()) ? owner->second : 0;
+	if (assigner == fCurrent)
+		return;
+
+	// Whatever assigned it is now depended on from outside...
+	for (int32_t region = assigner; !within(fRegions, fCurrent, region); region = fRegions[region].parent)
+		fRegions[region].standalone = false;
+	// ... and it is an input to every region between here and there.
+	for (int32_t region = fCurrent; !within(fRegions, assigner, region); region = fRegions[region].parent) {
+		if (fRegions[region].reads.count(name) == 0)
+			fRegions[region].reads.insert({name, value != nullptr ? CopyObject(value) : nullptr});
+	}
+}
+
+void Recorder::_assigned(const string& name)
+{
+	fOwners[name] = fCurrent;
+	for (int32_t region = fCurrent; region != 0; region = fRegions[region].parent)
+		fRegions[region].writes.insert(name);
+}
+
+void Recorder::_unrestorable(int32_t region)
+{
+	// Re-evaluating any region around this one would re-evaluate it, too.
+	for (; region != 0; region = fRegions[region].parent)
+		fRegions[region].standalone = false;
+}
+
+}
@@ -0,0 +1,139 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Script {
+
+// Predefinitions
+class CObject;
+class Stack;
+
+/*! Splits a run of the scripts into regions, one per `subdirectory` evaluated,
+ * and records what each one read from the variables outside of it and which
+ * ones it assigned. A region is "standalone" if evaluating it again on its
+ * own, with those variables restored, computes the same things: nothing
+ * outside of it read what it assigned or returned, and it read no superglobal
+ * native code may change. Snapshot uses this to re-evaluate only the
+ * subdirectories whose scripts changed.
+ *
+ * Only variables in the outermost scope are tracked, which is where scripts
+ * keep theirs (`subdirectory` does not push a scope.) Only one recorder can be
+ * active at a time; while none is, the hooks are a single null check. */
+class Recorder
+{
+public:
+	/*! Something a script did besides computing the build model, which has to
+	 * be done again when its region is restored rather than evaluated. */
+	struct Output {
+		enum Kind {
+			Write = 0,
+			Remove,
+			Print,
+		};
+		Kind kind;
+		std::string file; // or the message, for Print
+		std::string contents;
+	};
+	struct Region {
+		std::string path; // as given to `subdirectory`
+		std::string file; // the script that was evaluated
+		std::vector<std::string> directories; // the directory stack outside it
+		int32_t parent;
+		bool standalone;
+
+		// Variables from outside, as they were when first read (nullptr if
+		// undefined), and the ones it (or regions inside it) assigned.
+		std::map<std::string, std::shared_ptr<CObject> > reads;
+		std::set<std::string> writes;
+
+		// The ranges of the stack's input files, of the effects (see effect())
+		// and of the outputs that came from it, including from regions inside it.
+		size_t firstInputFile, inputFiles;
+		size_t firstEffect, effects;
+		size_t firstOutput, outputs;
+	};
+
+	Recorder();
+	~Recorder();
+
+	static inline bool active() { return sActive != nullptr; }
+	static inline int32_t current() { return sActive ? sActive->fCurrent : 0; }
+
+	// Region boundaries (see Interpreter.) A region can be suspended while
+	// it is evaluated on a child stack, and resumed to merge it back.
+	static inline int32_t enter(Stack* stack, const std::string& path, const std::string& file)
+		{ return sActive ? sActive->_enter(stack, path, file) : 0; }
+	static inline void leave(Stack* stack, const std::shared_ptr<CObject>& result)
+		{ if (sActive) sActive->_leave(stack, result); }
+	static inline void suspend()
+		{ if (sActive) sActive->fCurrent = sActive->fRegions[sActive->fCurrent].parent; }
+	static inline void resume(Stack* stack, int32_t region)
+		{ if (sActive) sActive->_resume(stack, region); }
+
+	// Accesses to variables in the outermost scope (see Stack.)
+	static inline void read(const std::string& name, const std::shared_ptr<CObject>& value)
+		{ if (sActive) sActive->_read(name, value); }
+	static inline void assigned(const std::string& name)
+		{ if (sActive) sActive->_assigned(name); }
+	// The current region depends on something that cannot be restored.
+	static inline void unrestorable()
+		{ if (sActive) sActive->_unrestorable(sActive->fCurrent); }
+
+	// Counts a side effect whose position among the others matters, i.e. a
+	// target being registered (see Target.)
+	static inline void effect()
+		{ if (sActive) sActive->fEffects++; }
+	// A script read a file that is not a script (see FileBuiltin.)
+	static inline void readFile(int32_t region, const std::string& file)
+		{ if (sActive) sActive->fFiles.push_back({file, region}); }
+	// A script wrote, removed or printed something (see Builtins.) Called from
+	// deferred actions, so that these are in the order a serial run does them.
+	static inline void output(Output::Kind kind, const std::string& file,
+			const std::string& contents = std::string())
+		{ if (sActive) sActive->fOutputs.push_back({kind, file, contents}); }
+
+	// Region 0 is everything outside of subdirectories.
+	const std::vector<Region>& regions() const { return fRegions; }
+
+	// Whether `region` is `ancestor` or inside of it, in `regions` (anything
+	// indexed by region with a `parent` for each, like regions() is.)
+	template<typename Regions>
+	static bool within(const Regions& regions, int32_t region, int32_t ancestor)
+	{
+		while (region != ancestor && region != 0)
+			region = regions[region].parent;
+		return region == ancestor;
+	}
+	const std::vector<std::pair<std::string, int32_t> >& files() const { return fFiles; }
+	const std::vector<Output>& outputs() const { return fOutputs; }
+
+private:
+	int32_t _enter(Stack* stack, const std::string& path, const std::string& file);
+	void _leave(Stack* stack, const std::shared_ptr<CObject>& result);
+	void _resume(Stack* stack, int32_t region);
+	void _read(const std::string& name, const std::shared_ptr<CObject>& value);
+	void _assigned(const std::string& name);
+	void _unrestorable(int32_t region);
+
+	static Recorder* sActive;
+	Recorder* fPrevious;
+
+	std::vector<Region> fRegions;
+	int32_t fCurrent;
+	// The region that last assigned each variable.
+	std::map<std::string, int32_t> fOwners;
+	size_t fEffects;
+	std::vector<std::pair<std::string, int32_t> > fFiles;
+	std::vector<Output> fOutputs;
+};
+
+}
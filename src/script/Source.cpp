@@ -0,0 +1,83 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "Source.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "util/FSUtil.h"
+
+using std::string;
+
+namespace Script {
+
+Source::Source()
+	:
+	fData(""),
+	fLength(0)
+{
+}
+
+SourceRef Source::fromFile(const string& path)
+{
+	Source* ret = new Source;
+	ret->fContents = FSUtil::getContents(path);
+	ret->fData = ret->fContents.data();
+	ret->fLength = ret->fContents.length();
+	return SourceRef(ret);
+}
+
+SourceRef Source::fromString(const string& code)
+{
+	Source* ret = new Source;
+	ret->fContents = code;
+	ret->fData = ret->fContents.data();
+	ret->fLength = ret->fContents.length();
+	return SourceRef(ret);
+}
+
+SourceView SourceView::view(size_t pos, size_t count) const
+{
+	if (pos > fLength)
+		throw std::out_of_range("SourceView::view");
+	SourceView ret = *this;
+	ret.fData += pos;
+	ret.fLength = std::min(count, fLength - pos);
+	return ret;
+}
+
+string SourceView::substr(size_t pos, size_t count) const
+{
+	if (pos > fLength)
+		throw std::out_of_range("SourceView::substr");
+	return string(fData + pos, std::min(count, fLength - pos));
+}
+
+int SourceView::compare(size_t pos, size_t count, const string& other) const
+{
+	if (pos > fLength)
+		throw std::out_of_range("SourceView::compare");
+	count = std::min(count, fLength - pos);
+	const int ret = other.compare(0, string::npos, fData + pos, count);
+	return -ret;
+}
+
+size_t SourceView::find(const string& needle, size_t pos) const
+{
+	if (pos > fLength)
+		return npos;
+	const char* end = fData + fLength;
+	const char* found = std::search(fData + pos, end, needle.begin(), needle.end());
+	return (found == end && !needle.empty()) ? npos : found - fData;
+}
+
+SourceView SourceView::owned() const
+{
+	if (fSource)
+		return *this;
+	return SourceView(Source::fromString(str()));
+}
+
+}
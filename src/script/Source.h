@@ -0,0 +1,77 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Script {
+
+/*! A script's source code, which never changes once loaded: a file read in
+ * one go, or a copy of a string. Function bodies refer into it through
+ * SourceViews, which keep it alive, rather than being copied out of it.
+ *
+ * Files are not mapped: with `--watch`, a function defined in a script can
+ * outlive an editor truncating it, and touching a mapping past the new end
+ * raises SIGBUS. */
+class Source
+{
+public:
+	// An empty source if the file can't be read (as with FSUtil::getContents.)
+	static std::shared_ptr<const Source> fromFile(const std::string& path);
+	static std::shared_ptr<const Source> fromString(const std::string& code);
+
+	const char* data() const { return fData; }
+	size_t length() const { return fLength; }
+
+private:
+	Source();
+	Source(const Source&) = delete;
+	Source& operator=(const Source&) = delete;
+
+	const char* fData;
+	size_t fLength;
+	std::string fContents;
+};
+typedef std::shared_ptr<const Source> SourceRef;
+
+/*! A range of a Source, or of a string that outlives the view, which is what
+ * the interpreter parses. It reads like a const std::string: in particular,
+ * indexing at (or past) the end gives '\0' even if the range goes on. */
+class SourceView
+{
+public:
+	static const size_t npos = std::string::npos;
+
+	SourceView() : fData(""), fLength(0) {}
+	SourceView(const SourceRef& source)
+		: fSource(source), fData(source->data()), fLength(source->length()) {}
+	// Doesn't copy `string`, which must outlive the view.
+	SourceView(const std::string& string) : fData(string.data()), fLength(string.length()) {}
+
+	char operator[](size_t i) const { return i < fLength ? fData[i] : '\0'; }
+	size_t length() const { return fLength; }
+	bool empty() const { return fLength == 0; }
+	const char* data() const { return fData; }
+	// Null if this refers to a string.
+	const SourceRef& source() const { return fSource; }
+
+	SourceView view(size_t pos, size_t count = npos) const;
+	std::string substr(size_t pos, size_t count = npos) const;
+	std::string str() const { return std::string(fData, fLength); }
+	int compare(size_t pos, size_t count, const std::string& other) const;
+	size_t find(const std::string& needle, size_t pos = 0) const;
+
+	// A view of a copy of this, if it doesn't keep what it refers to alive.
+	SourceView owned() const;
+
+private:
+	SourceRef fSource;
+	const char* fData;
+	size_t fLength;
+};
+
+}
@@ -16,6 +16,12 @@ using std::vector;
 namespace Script {
 
 Stack::Stack()
+	:
+	mProfiler(nullptr),
+	mParallelJobs(1),
+	mNativeLock(nullptr),
+	fIsChild(false),
+	fRegion(0)
 {
 	push();
 	addSuperglobal("Phoenix", std::make_shared<Script::GlobalPhoenixObject>(this));
@@ -49,8 +55,14 @@ Object Stack::get_ptr(const vector<string> variable)
 		string var = variable[0];
 		var = var.substr(1);
 		ret = fSuperglobalScope.get_ptr(var);
-	} else
-		ret = fStack[getPos(variable[0])].get_ptr(variable[0]);
+		if (!fIsChild && isVolatileSuperglobal(var))
+			Recorder::unrestorable();
+	} else {
+		std::vector<ObjectMap>::size_type pos = getPos(variable[0]);
+		ret = fStack[pos].get_ptr(variable[0]);
+		if (pos == 0 && !fIsChild)
+			Recorder::read(variable[0], ret);
+	}
 	for (vector<string>::size_type i = 1; i < variable.size(); i++) {
 		if (ret == nullptr)
 			return UndefinedObject();
@@ -86,6 +98,12 @@ void Stack::set_ptr(vector<string> variable, Object value, bool forceLocal)
 		fStack[fStack.size() - 1].set_ptr(variable[0], value);
 
 	vector<ObjectMap>::size_type loc = getPos(variable[0]);
+	if (loc == 0 && !fIsChild && Recorder::active()) {
+		// Assigning to a member modifies what was there before.
+		if (variable.size() > 1)
+			Recorder::read(variable[0], fStack[loc].get_ptr(variable[0]));
+		Recorder::assigned(variable[0]);
+	}
 	if (variable.size() == 1) {
 		fStack[loc].set_ptr(variable[0], value);
 		return;
@@ -122,9 +140,54 @@ void Stack::set_ptr(vector<string> variable, Object value, bool forceLocal)
 	}
 }
 
-void Stack::addSuperglobal(string variableName, Object value)
+void Stack::addSuperglobal(string variableName, Object value, bool isVolatile)
 {
 	fSuperglobalScope.set(variableName, value);
+	if (isVolatile)
+		fVolatileSuperglobals.insert(variableName);
+}
+
+Stack* Stack::createChild(const std::set<string>& variables, std::recursive_mutex* nativeLock)
+{
+	Stack* child = new Stack;
+	child->GlobalFunctions.insert(GlobalFunctions.begin(), GlobalFunctions.end());
+	child->fSuperglobalScope = fSuperglobalScope;
+	child->fVolatileSuperglobals = fVolatileSuperglobals;
+	child->fDirectoryStack = fDirectoryStack;
+	child->fIsChild = true;
+	child->fRegion = Recorder::current();
+	for (const string& variable : variables) {
+		Object value = get_ptr({variable});
+		if (value == nullptr)
+			continue;
+		child->set_ptr({variable}, CopyObject(value), true);
+		child->fInheritedVariables.insert(variable);
+	}
+	child->mNativeLock = nativeLock;
+	return child;
+}
+
+void Stack::joinChild(Stack* child)
+{
+	// Variables the subdirectory created end up where they would have, had
+	// it been evaluated on this stack.
+	const ObjectMap& scope = child->fStack[0];
+	for (ObjectMap::const_iterator it = scope.begin(); it != scope.end(); it++) {
+		if (child->fInheritedVariables.count(it->first) == 0)
+			set_ptr({it->first}, it->second);
+	}
+	fInputFiles.insert(fInputFiles.end(), child->fInputFiles.begin(), child->fInputFiles.end());
+	for (const std::function<void()>& action : child->fDeferred)
+		defer(action);
+	child->fDeferred.clear();
+}
+
+void Stack::defer(const std::function<void()>& action)
+{
+	if (fIsChild)
+		fDeferred.push_back(action);
+	else
+		action();
 }
 
 void Stack::print()
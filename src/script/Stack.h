@@ -5,14 +5,20 @@
 #pragma once
 
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "Function.h"
 #include "Object.h"
+#include "Recorder.h"
 
 namespace Script {
 
+// Predefinitions
+class Profiler;
+
 class Stack
 {
 public:
@@ -33,31 +39,65 @@ public:
 		return get(variable); }
 	void set_ptr(std::vector<std::string> variable, Object value, bool forceLocal = false);
 	inline void set(std::vector<std::string> variable, Object value) { set_ptr(variable, CopyObject(value)); }
+	// Like get_ptr, but not seen by the Recorder.
+	inline Object peek(const std::string& variable) { return fStack[getPos(variable)].get_ptr(variable); }
+	inline bool defined(const std::string& variable) { return peek(variable) != nullptr; }
 
-	void addSuperglobal(std::string variableName, Object value);
+	// Volatile superglobals are ones native code may change while scripts run.
+	void addSuperglobal(std::string variableName, Object value, bool isVolatile = false);
+	inline bool isVolatileSuperglobal(const std::string& name) const
+		{ return fVolatileSuperglobals.count(name) != 0; }
+	inline Object getSuperglobal(const std::string& name) { return fSuperglobalScope.get_ptr(name); }
 
 	inline void pushDir(const std::string& dir) { fDirectoryStack.push_back(dir); }
 	inline void popDir() { fDirectoryStack.pop_back(); }
 	inline std::string currentDir() { return fDirectoryStack[fDirectoryStack.size() - 1]; }
 	inline size_t dirDepth() { return fDirectoryStack.size(); }
+	inline const std::vector<std::string>& directories() const { return fDirectoryStack; }
 
 	inline void appendInputFile(const std::string& path) { fInputFiles.push_back(path); }
 	inline std::string currentInputFile() { return fInputFiles[fInputFiles.size() - 1]; }
 	inline std::vector<std::string> inputFiles() { return fInputFiles; }
+	inline size_t inputFileCount() const { return fInputFiles.size(); }
 
 	void print();
 
 	// Debugger hooks
-	std::function<void(const std::string& path, const std::string& code,
+	std::function<void(const std::string& path, const SourceView& code,
 		const uint32_t line)> mInterpreterHook;
+	Profiler* mProfiler;
+	// Checked once per EvalString, so a hook attached while code is running
+	// takes effect from the next file or function body on.
+	inline bool instrumented() const
+		{ return mInterpreterHook || mProfiler != nullptr || MemoryProfiler::active(); }
+
+	// Parallel subdirectory evaluation (see RunParallel.) A child stack starts
+	// with copies of the given variables, and calls native functions under
+	// the lock; joining it merges back the variables it created.
+	unsigned int mParallelJobs;
+	std::recursive_mutex* mNativeLock;
+	Stack* createChild(const std::set<std::string>& variables, std::recursive_mutex* nativeLock);
+	void joinChild(Stack* child);
+	// Runs the action now, or on a child stack, once it is joined (so that
+	// the order of side effects doesn't depend on which child finished first.)
+	void defer(const std::function<void()>& action);
+
+	// The Recorder region code on this stack is part of.
+	inline int32_t region() const { return fIsChild ? fRegion : Recorder::current(); }
 
 private:
 	ObjectMap fSuperglobalScope;
+	std::set<std::string> fVolatileSuperglobals;
 	std::vector<ObjectMap> fStack;
 	std::vector<std::string> fDirectoryStack;
 
 	std::vector<std::string> fInputFiles;
 
+	bool fIsChild;
+	int32_t fRegion;
+	std::set<std::string> fInheritedVariables;
+	std::vector<std::function<void()> > fDeferred;
+
 	std::vector<ObjectMap>::size_type getPos(std::string variable);
 };
 
@@ -5,24 +5,40 @@
 #include "FSUtil.h"
 
 #include "OSUtil.h"
+#include "Path.h"
 #include "StringUtil.h"
+#include "TraceUtil.h"
 
 #include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <cctype>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 
 #ifndef _MSC_VER
 #  include <sys/types.h>
 #  include <sys/stat.h>
 #  include <unistd.h>
 #  include <dirent.h>
-#  include <cstring>
+#  include <fcntl.h>
+#  include <utime.h>
+#  include <cerrno>
 #else /* _MSC_VER */
 #  define WIN32_LEAN_AND_MEAN
 #  include <direct.h>
+#  include <sys/utime.h>
 #  include <windows.h>
 #  define PATH_MAX MAX_PATH
 #endif
@@ -32,46 +48,126 @@ using std::vector;
 
 // Static member variables
 vector<string> FSUtil::fPATHs;
+unsigned int FSUtil::sSearchJobs = 1;
 
-bool FSUtil::exists(const string& path)
+// The sub-second part of a stat() result's modification time, where known;
+// macOS names the field differently.
+static int64_t FSUtil_mtimeNanoseconds(const struct ::stat& statbuf)
 {
-	string filename = path;
-#ifdef _WIN32
-	StringUtil::replaceAll(filename, "/", "\\");
+#if defined(__APPLE__)
+	return statbuf.st_mtimespec.tv_nsec;
+#elif defined(_MSC_VER)
+	(void)statbuf;
+	return 0;
+#else
+	return statbuf.st_mtim.tv_nsec;
 #endif
+}
+
+/* What stat() said about each path asked about, so that every path is only
+ * stat()ed once; FSUtil's own changes to the filesystem update it. */
+struct FSUtil_Metadata {
+	bool exists;
+	unsigned int mode;
+};
+static std::mutex sFSUtil_metadataLock;
+static std::unordered_map<string, FSUtil_Metadata> sFSUtil_metadata;
+static uint64_t sFSUtil_metadataQueries = 0, sFSUtil_metadataStats = 0;
 
-	std::ifstream f(filename);
-	return static_cast<bool>(f);
+static FSUtil_Metadata FSUtil_metadata(const string& path)
+{
+	{
+		std::lock_guard<std::mutex> guard(sFSUtil_metadataLock);
+		sFSUtil_metadataQueries++;
+		std::unordered_map<string, FSUtil_Metadata>::const_iterator it = sFSUtil_metadata.find(path);
+		if (it != sFSUtil_metadata.end())
+			return it->second;
+	}
+	struct ::stat statbuf;
+	FSUtil_Metadata metadata;
+	metadata.exists = ::stat(path.c_str(), &statbuf) == 0;
+	metadata.mode = metadata.exists ? statbuf.st_mode : 0;
+
+	std::lock_guard<std::mutex> guard(sFSUtil_metadataLock);
+	sFSUtil_metadataStats++;
+	sFSUtil_metadata[path] = metadata;
+	return metadata;
+}
+
+void FSUtil::invalidateMetadata(const string& path)
+{
+	std::lock_guard<std::mutex> guard(sFSUtil_metadataLock);
+	sFSUtil_metadata.erase(path);
+}
+
+/* What which() found in PATH for each program it was asked about, including
+ * nothing. The directory cache can carry these over from one run to the next,
+ * along with a "stamp" of PATH (its directories, and when each was last
+ * modified), and they are only reused if the stamp is still the same. */
+static std::mutex sFSUtil_whichLock;
+static std::map<string, string> sFSUtil_which;
+static string sFSUtil_whichStamp;
+static bool sFSUtil_whichStamped = false, sFSUtil_whichChanged = false;
+static std::map<string, string> sFSUtil_savedWhich;
+static string sFSUtil_savedWhichStamp;
+
+// Empty if a directory was modified just now (see FSUtil_listDirectory.)
+static string FSUtil_whichStamp(const vector<string>& paths)
+{
+	string ret;
+	for (const string& path : paths) {
+		struct ::stat statbuf;
+		if (::stat(path.c_str(), &statbuf) != 0) {
+			ret += "- ";
+		} else {
+			if ((int64_t)statbuf.st_mtime >= (int64_t)::time(nullptr) - 1)
+				return "";
+			ret += std::to_string((int64_t)statbuf.st_mtime) + "." +
+				std::to_string(FSUtil_mtimeNanoseconds(statbuf)) + " ";
+		}
+		ret += path + "\t";
+	}
+	return ret;
+}
+
+void FSUtil::clearMetadataCache()
+{
+	{
+		std::lock_guard<std::mutex> guard(sFSUtil_metadataLock);
+		sFSUtil_metadata.clear();
+	}
+	std::lock_guard<std::mutex> guard(sFSUtil_whichLock);
+	sFSUtil_which.clear();
+	sFSUtil_whichStamped = false;
+}
+
+void FSUtil::metadataStatistics(uint64_t& queries, uint64_t& stats)
+{
+	std::lock_guard<std::mutex> guard(sFSUtil_metadataLock);
+	queries = sFSUtil_metadataQueries;
+	stats = sFSUtil_metadataStats;
+}
+
+bool FSUtil::exists(const string& path)
+{
+	return FSUtil_metadata(path).exists;
 }
 
 bool FSUtil::isFile(const string& path)
 {
-	struct ::stat statbuf;
-	if (::stat(path.c_str(), &statbuf) == -1)
-		return false;
-	if (statbuf.st_mode & S_IFREG)
-		return true;
-	return false;
+	return (FSUtil_metadata(path).mode & S_IFREG) != 0;
 }
 
 bool FSUtil::isDir(const string& path)
 {
-	struct ::stat statbuf;
-	if (::stat(path.c_str(), &statbuf) == -1)
-		return false;
-	if (statbuf.st_mode & S_IFDIR)
-		return true;
-	return false;
+	return (FSUtil_metadata(path).mode & S_IFDIR) != 0;
 }
 
 bool FSUtil::isExec(const string& path)
 {
 #ifndef _WIN32
-	struct ::stat statbuf;
-	if (::stat(path.c_str(), &statbuf) == 0) {
-		return ((statbuf.st_mode & S_IFREG) && (statbuf.st_mode & 0111));
-	}
-	return false;
+	const unsigned int mode = FSUtil_metadata(path).mode;
+	return (mode & S_IFREG) && (mode & 0111);
 #else
 	return !path.empty() && isFile(path); // Because who knows, anyway.
 #endif
@@ -88,57 +184,558 @@ bool FSUtil::isPathAbsolute(const string& path)
 
 string FSUtil::getContents(const string& file)
 {
+#ifndef _MSC_VER
+	// Read straight into a string of the file's size, rather than a character
+	// at a time through a stream.
+	const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return string();
+	string ret;
+	struct ::stat statbuf;
+	if (::fstat(fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode))
+		ret.resize(statbuf.st_size);
+	string::size_type length = 0;
+	while (true) {
+		ssize_t count;
+		if (length < ret.length()) {
+			count = ::read(fd, &ret[length], ret.length() - length);
+		} else {
+			// It grew since (or its size wasn't known.)
+			char buffer[4096];
+			count = ::read(fd, buffer, sizeof(buffer));
+			if (count > 0)
+				ret.append(buffer, count);
+		}
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			break;
+		length += count;
+	}
+	::close(fd);
+	ret.resize(length);
+	return ret;
+#else
 	std::ifstream filestream(file);
 	// extra ()s here are supposedly mandatory?
 	return string((std::istreambuf_iterator<char>(filestream)),
 		std::istreambuf_iterator<char>());
+#endif
 }
 
 bool FSUtil::setContents(const string& file, const string& contents)
 {
+	invalidateMetadata(file);
 	std::ofstream filestream(file);
 	filestream << contents;
 	filestream.close();
 	return filestream.good();
 }
 
+// How much of a file is compared against what is to be written at a time.
+static const size_t kFSUtil_compareChunk = 64 * 1024;
+
+// Whether the next `length` bytes of `stream` are `data`; `buffer` is scratch space.
+static bool FSUtil_streamMatches(FILE* stream, const char* data, size_t length, string& buffer)
+{
+	buffer.resize(kFSUtil_compareChunk);
+	while (length > 0) {
+		const size_t count = std::min(length, buffer.length());
+		if (fread(&buffer[0], 1, count, stream) != count ||
+				memcmp(buffer.data(), data, count) != 0)
+			return false;
+		data += count;
+		length -= count;
+	}
+	return true;
+}
+
+bool FSUtil::setContentsIfChanged(const string& file, const string& contents)
+{
+	FILE* stream = fopen(file.c_str(), "rb");
+	if (stream != nullptr) {
+		// The sizes differing settles it without reading anything.
+		string buffer;
+		const bool same = fseek(stream, 0, SEEK_END) == 0 &&
+			ftell(stream) == (long)contents.length() && fseek(stream, 0, SEEK_SET) == 0 &&
+			FSUtil_streamMatches(stream, contents.data(), contents.length(), buffer) &&
+			fgetc(stream) == EOF;
+		fclose(stream);
+		if (same)
+			return true;
+	}
+	return setContents(file, contents);
+}
+
+bool FSUtil::touch(const string& file)
+{
+	invalidateMetadata(file);
+#ifndef _MSC_VER
+	return ::utime(file.c_str(), nullptr) == 0;
+#else
+	return ::_utime(file.c_str(), nullptr) == 0;
+#endif
+}
+
+FSUtil::AtomicWriter::AtomicWriter(const string& file, size_t bufferSize)
+	:
+	fFile(file),
+	fTemporaryFile(file + ".tmp"),
+	fBufferSize(bufferSize),
+	fExisting(fopen(file.c_str(), "rb")),
+	fMatched(0),
+	fStream(nullptr),
+	fTemporaryExists(false),
+	fFinished(false),
+	fUnchanged(false),
+	fFailed(false)
+{
+	fBuffer.reserve(bufferSize);
+}
+
+FSUtil::AtomicWriter::~AtomicWriter()
+{
+	if (fExisting != nullptr)
+		fclose(fExisting);
+	if (fStream != nullptr)
+		fclose(fStream);
+	if (!fTemporaryExists)
+		return;
+	::remove(fTemporaryFile.c_str());
+	invalidateMetadata(fTemporaryFile);
+}
+
+void FSUtil::AtomicWriter::write(const string& data)
+{
+	fBuffer += data;
+	if (fBuffer.length() >= fBufferSize)
+		_flush();
+}
+
+bool FSUtil::AtomicWriter::_matchesExisting()
+{
+	return fExisting != nullptr &&
+		FSUtil_streamMatches(fExisting, fBuffer.data(), fBuffer.length(), fExistingBuffer);
+}
+
+void FSUtil::AtomicWriter::_diverge()
+{
+	invalidateMetadata(fTemporaryFile);
+	fStream = fopen(fTemporaryFile.c_str(), "wb");
+	fTemporaryExists = (fStream != nullptr);
+	fFailed = (fStream == nullptr);
+	if (fExisting == nullptr)
+		return;
+
+	// Start the temporary file off with what matched, which wasn't kept.
+	fFailed = fFailed || fseek(fExisting, 0, SEEK_SET) != 0;
+	fExistingBuffer.resize(kFSUtil_compareChunk);
+	for (uint64_t left = fMatched; left > 0 && !fFailed; ) {
+		const size_t count = (size_t)std::min<uint64_t>(left, fExistingBuffer.length());
+		fFailed = fread(&fExistingBuffer[0], 1, count, fExisting) != count ||
+			fwrite(fExistingBuffer.data(), 1, count, fStream) != count;
+		left -= count;
+	}
+	fclose(fExisting);
+	fExisting = nullptr;
+	fExistingBuffer = string();
+}
+
+void FSUtil::AtomicWriter::_flush()
+{
+	if (fStream == nullptr && !fFailed) {
+		if (_matchesExisting()) {
+			fMatched += fBuffer.length();
+			fBuffer.clear();
+			return;
+		}
+		_diverge();
+	}
+	if (fStream != nullptr && !fBuffer.empty())
+		fFailed = fFailed || fwrite(fBuffer.data(), 1, fBuffer.length(), fStream) != fBuffer.length();
+	fBuffer.clear();
+}
+
+bool FSUtil::AtomicWriter::finish()
+{
+	if (fFinished)
+		return !fFailed;
+	fFinished = true;
+	if (fStream == nullptr && !fFailed) {
+		if (_matchesExisting() && fgetc(fExisting) == EOF) {
+			// Nothing changed, so the file can be left be.
+			fclose(fExisting);
+			fExisting = nullptr;
+			fUnchanged = true;
+		} else {
+			_diverge();
+		}
+	}
+	if (!fUnchanged)
+		_flush();
+	fBuffer = string();
+	fExistingBuffer = string();
+	if (fStream != nullptr) {
+		fFailed = (fclose(fStream) != 0) || fFailed;
+		fStream = nullptr;
+		invalidateMetadata(fTemporaryFile);
+	}
+	return !fFailed;
+}
+
+bool FSUtil::AtomicWriter::commit()
+{
+	if (!finish())
+		return false;
+	if (fUnchanged)
+		return true;
+	invalidateMetadata(fFile);
+	invalidateMetadata(fTemporaryFile);
+#ifndef _MSC_VER
+	fTemporaryExists = ::rename(fTemporaryFile.c_str(), fFile.c_str()) != 0;
+#else
+	fTemporaryExists = !MoveFileExA(fTemporaryFile.c_str(), fFile.c_str(), MOVEFILE_REPLACE_EXISTING);
+#endif
+	// (If that failed, the destructor removes the temporary file.)
+	return !fTemporaryExists;
+}
+
 bool FSUtil::deleteFile(const string& file)
 {
+	invalidateMetadata(file);
 	return (::remove(file.c_str()) == 0);
 }
 
+// Matches paths against a set of extensions (or other suffixes.)
+class FSUtil_ExtensionMatcher
+{
+public:
+	FSUtil_ExtensionMatcher(const vector<string>& exts)
+	{
+		// Anything that isn't a plain ".ext" has to be compared the long way.
+		for (const string& ext : exts) {
+			if (ext.length() > 1 && ext[0] == '.' && ext.find('.', 1) == string::npos)
+				fExtensions.insert(ext);
+			else
+				fSuffixes.push_back(ext);
+		}
+	}
+
+	bool matches(const string& path) const
+	{
+		const string::size_type dot = path.rfind('.');
+		if (dot != string::npos && !fExtensions.empty() &&
+				fExtensions.count(path.substr(dot)) != 0)
+			return true;
+		for (const string& suffix : fSuffixes) {
+			if (StringUtil::endsWith(path, suffix))
+				return true;
+		}
+		return false;
+	}
+
+private:
+	std::unordered_set<string> fExtensions;
+	vector<string> fSuffixes;
+};
+
 #ifndef _MSC_VER
-void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
-	const vector<string>& exts, bool recursive)
+/* Directory listings, cached by the directory's identity and modification
+ * time, which changes whenever an entry is added, removed or renamed. */
+struct FSUtil_Listing {
+	uint64_t device, inode;
+	int64_t seconds, nanoseconds;
+	vector<std::pair<string, bool> > entries; // names, and whether they're directories
+	bool cacheable;
+};
+typedef std::shared_ptr<const FSUtil_Listing> FSUtil_ListingRef;
+struct FSUtil_CachedListing {
+	FSUtil_ListingRef listing;
+	bool used;
+};
+static std::mutex sFSUtil_listingsLock;
+static std::unordered_map<string, FSUtil_CachedListing> sFSUtil_listings;
+static bool sFSUtil_listingsChanged = false;
+
+static FSUtil_ListingRef FSUtil_listDirectory(const string& dir)
 {
+	struct ::stat statbuf;
+	if (::stat(dir.c_str(), &statbuf) != 0 || !S_ISDIR(statbuf.st_mode))
+		return nullptr;
+	{
+		std::lock_guard<std::mutex> guard(sFSUtil_listingsLock);
+		std::unordered_map<string, FSUtil_CachedListing>::iterator it = sFSUtil_listings.find(dir);
+		if (it != sFSUtil_listings.end()) {
+			const FSUtil_Listing& cached = *it->second.listing;
+			if (cached.cacheable && cached.device == (uint64_t)statbuf.st_dev &&
+					cached.inode == (uint64_t)statbuf.st_ino &&
+					cached.seconds == (int64_t)statbuf.st_mtime &&
+					cached.nanoseconds == FSUtil_mtimeNanoseconds(statbuf)) {
+				it->second.used = true;
+				return it->second.listing;
+			}
+		}
+	}
+
 	DIR* dp = ::opendir(dir.c_str());
 	if (dp == nullptr) {
 		// Path does not exist or could not be read
-		return;
+		return nullptr;
 	}
-
+	std::shared_ptr<FSUtil_Listing> listing = std::make_shared<FSUtil_Listing>();
+	listing->device = statbuf.st_dev;
+	listing->inode = statbuf.st_ino;
+	listing->seconds = statbuf.st_mtime;
+	listing->nanoseconds = FSUtil_mtimeNanoseconds(statbuf);
 	struct ::dirent* entry;
 	while ((entry = ::readdir(dp)) != nullptr) {
 		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
 			continue;
-		string fullPath = FSUtil::combinePaths({dir, entry->d_name});
-		if (recursive && FSUtil::isDir(fullPath))
-			FSUtil_fileSearchHelper(ret, fullPath, exts, recursive);
-		else {
-			for (string ext : exts) {
-				if (StringUtil::endsWith(fullPath, ext)) {
-					ret.push_back(fullPath);
-					break;
+		bool isDir = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+			isDir = FSUtil::isDir(dir + "/" + entry->d_name);
+		listing->entries.push_back({entry->d_name, isDir});
+	}
+	closedir(dp);
+
+	// If it was modified just now, it could be modified again within the
+	// same timestamp, and that would go unnoticed; so don't reuse it.
+	listing->cacheable = listing->seconds < (int64_t)::time(nullptr) - 1;
+	std::lock_guard<std::mutex> guard(sFSUtil_listingsLock);
+	sFSUtil_listings[dir] = {listing, true};
+	sFSUtil_listingsChanged = true;
+	return listing;
+}
+
+// What entries of `dir` are prefixed with, i.e. the equivalent of
+// combinePaths({dir, name}) is this plus the name.
+static string FSUtil_entryPrefix(const string& dir)
+{
+	string prefix = FSUtil::normalizePath(dir);
+	if (!prefix.empty())
+		prefix += "/";
+	else if (FSUtil::isPathAbsolute(dir))
+		prefix = "/";
+	return prefix;
+}
+
+typedef std::unordered_map<string, FSUtil_ListingRef> FSUtil_Tree;
+
+/* Lists `dir` (and, if `recursive`, every directory under it) into `tree`.
+ * Directories are handed out to up to FSUtil::sSearchJobs threads from a
+ * shared stack, with more threads started only once there is a backlog, so
+ * small trees never leave the calling thread. */
+static void FSUtil_listTree(FSUtil_Tree& tree, const string& dir, bool recursive)
+{
+	std::mutex lock;
+	std::condition_variable wakeup;
+	vector<string> pending = {dir};
+	size_t busy = 0;
+	vector<std::thread> threads;
+	const std::function<void(bool)> worker = [&](bool spawner) {
+		std::unique_lock<std::mutex> guard(lock);
+		for (;;) {
+			wakeup.wait(guard, [&]() { return !pending.empty() || busy == 0; });
+			if (pending.empty())
+				break;
+			const string directory = pending.back();
+			pending.pop_back();
+			busy++;
+			guard.unlock();
+
+			const FSUtil_ListingRef listing = FSUtil_listDirectory(directory);
+			vector<string> subdirectories;
+			if (recursive && listing != nullptr) {
+				const string prefix = FSUtil_entryPrefix(directory);
+				for (const std::pair<string, bool>& entry : listing->entries) {
+					if (entry.second)
+						subdirectories.push_back(prefix + entry.first);
+				}
+			}
+
+			guard.lock();
+			tree[directory] = listing;
+			// (In reverse, so the first ones are listed first.)
+			pending.insert(pending.end(), subdirectories.rbegin(), subdirectories.rend());
+			busy--;
+			wakeup.notify_all();
+			if (spawner && pending.size() > 1 && threads.size() + 1 < FSUtil::sSearchJobs) {
+				try {
+					threads.push_back(std::thread(worker, false));
+				} catch (const std::system_error&) {
+					// No (more) threads available; make do with what we have.
 				}
 			}
 		}
+	};
+	worker(true);
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+static void FSUtil_fileSearchHelper(vector<string>& ret, const FSUtil_Tree& tree,
+	const string& dir, const FSUtil_ExtensionMatcher& exts, bool recursive,
+	vector<string>* directories)
+{
+	const FSUtil_Tree::const_iterator it = tree.find(dir);
+	if (it == tree.end() || it->second == nullptr)
+		return;
+	if (directories != nullptr)
+		directories->push_back(dir);
+
+	const string prefix = FSUtil_entryPrefix(dir);
+	for (const std::pair<string, bool>& entry : it->second->entries) {
+		if (recursive && entry.second)
+			FSUtil_fileSearchHelper(ret, tree, prefix + entry.first, exts, recursive, directories);
+		else if (exts.matches(prefix + entry.first))
+			ret.push_back(prefix + entry.first);
 	}
+}
 
-	closedir(dp);
+void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
+	const FSUtil_ExtensionMatcher& exts, bool recursive, vector<string>* directories)
+{
+	// The directories are listed in parallel, and the results put together
+	// afterwards in the order a depth-first walk would find them.
+	FSUtil_Tree tree;
+	FSUtil_listTree(tree, dir, recursive);
+	FSUtil_fileSearchHelper(ret, tree, dir, exts, recursive, directories);
+}
+
+static const char* kFSUtil_cacheMagic = "PHNXDIRS2";
+
+bool FSUtil::loadDirectoryCache(const string& file)
+{
+	std::ifstream stream(file);
+	string line;
+	if (!std::getline(stream, line) || line != kFSUtil_cacheMagic)
+		return false;
+	std::unordered_map<string, FSUtil_CachedListing> listings;
+	std::map<string, string> which;
+	string whichStamp;
+	while (std::getline(stream, line)) {
+		// S <stamp of PATH>, and then W <program>\t<where it was found>
+		if (line.compare(0, 2, "S ") == 0) {
+			whichStamp = line.substr(2);
+			continue;
+		}
+		if (line.compare(0, 2, "W ") == 0) {
+			const string::size_type tab = line.find('\t');
+			if (tab == string::npos)
+				return false;
+			which[line.substr(2, tab - 2)] = line.substr(tab + 1);
+			continue;
+		}
+
+		// D <device> <inode> <seconds> <nanoseconds> <entries> <path>
+		unsigned long long device, inode, count;
+		long long seconds, nanoseconds;
+		int pathStart = -1;
+		if (sscanf(line.c_str(), "D %llu %llu %lld %lld %llu %n", &device, &inode,
+				&seconds, &nanoseconds, &count, &pathStart) != 5 || pathStart < 0)
+			return false;
+		const string path = line.substr(pathStart);
+		std::shared_ptr<FSUtil_Listing> listing = std::make_shared<FSUtil_Listing>();
+		listing->device = device;
+		listing->inode = inode;
+		listing->seconds = seconds;
+		listing->nanoseconds = nanoseconds;
+		listing->cacheable = true;
+		listing->entries.reserve(count);
+		for (unsigned long long i = 0; i < count; i++) {
+			if (!std::getline(stream, line) || line.empty())
+				return false;
+			listing->entries.push_back({line.substr(1), line[0] == 'd'});
+		}
+		listings[path] = {listing, false};
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(sFSUtil_whichLock);
+		sFSUtil_savedWhich.swap(which);
+		sFSUtil_savedWhichStamp = whichStamp;
+		sFSUtil_whichChanged = false;
+	}
+	std::lock_guard<std::mutex> guard(sFSUtil_listingsLock);
+	sFSUtil_listings.swap(listings);
+	sFSUtil_listingsChanged = false;
+	return true;
+}
+
+bool FSUtil::saveDirectoryCache(const string& file)
+{
+	std::lock_guard<std::mutex> guard(sFSUtil_listingsLock);
+	std::lock_guard<std::mutex> whichGuard(sFSUtil_whichLock);
+
+	// Listings that weren't used this time are dropped, so the cache only
+	// holds what the last run searched.
+	bool unused = false;
+	for (const std::pair<const string, FSUtil_CachedListing>& it : sFSUtil_listings)
+		unused = unused || !it.second.used;
+	if (!sFSUtil_listingsChanged && !sFSUtil_whichChanged && !unused)
+		return true;
+
+	string contents = string(kFSUtil_cacheMagic) + "\n";
+	// If which() wasn't used this time, what it found last time is kept.
+	const string& whichStamp = sFSUtil_whichStamped ? sFSUtil_whichStamp : sFSUtil_savedWhichStamp;
+	const std::map<string, string>& which = sFSUtil_whichStamped ? sFSUtil_which : sFSUtil_savedWhich;
+	if (!whichStamp.empty() && whichStamp.find('\n') == string::npos) {
+		contents += "S " + whichStamp + "\n";
+		for (const std::pair<const string, string>& it : which) {
+			if (it.first.find_first_of("\t\n") == string::npos &&
+					it.second.find('\n') == string::npos)
+				contents += "W " + it.first + "\t" + it.second + "\n";
+		}
+	}
+	for (const std::pair<const string, FSUtil_CachedListing>& it : sFSUtil_listings) {
+		const FSUtil_Listing& listing = *it.second.listing;
+		if (!it.second.used || !listing.cacheable || it.first.find('\n') != string::npos)
+			continue;
+		string entries;
+		size_t count = 0;
+		for (const std::pair<string, bool>& entry : listing.entries) {
+			if (entry.first.find('\n') != string::npos)
+				break;
+			entries += (entry.second ? "d" : "f") + entry.first + "\n";
+			count++;
+		}
+		// (A name that can't be written means the listing can't be, either.)
+		if (count != listing.entries.size())
+			continue;
+		contents += "D " + std::to_string(listing.device) + " " + std::to_string(listing.inode) +
+			" " + std::to_string(listing.seconds) + " " + std::to_string(listing.nanoseconds) +
+			" " + std::to_string(count) + " " + it.first + "\n" + entries;
+	}
+	if (!setContents(file, contents))
+		return false;
+	sFSUtil_listingsChanged = false;
+	sFSUtil_whichChanged = false;
+	return true;
+}
+
+void FSUtil::clearDirectoryCache()
+{
+	std::lock_guard<std::mutex> guard(sFSUtil_listingsLock);
+	sFSUtil_listings.clear();
+	sFSUtil_listingsChanged = true;
 }
 #else /* _MSC_VER  */
+bool FSUtil::loadDirectoryCache(const string&)
+{
+	return false;
+}
+
+bool FSUtil::saveDirectoryCache(const string&)
+{
+	return false;
+}
+
+void FSUtil::clearDirectoryCache()
+{
+}
+
 void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
-	const vector<string>& exts, bool recursive)
+	const FSUtil_ExtensionMatcher& exts, bool recursive, vector<string>* directories)
 {
 	// Specify a file mask.
 	string path = dir + "\\*";
@@ -149,6 +746,8 @@ void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
 		// Path not found
 		return;
 	}
+	if (directories != nullptr)
+		directories->push_back(FSUtil::normalizePath(dir));
 
 	do {
 		if (strcmp(file.cFileName, ".") == 0 || strcmp(file.cFileName, "..") == 0)
@@ -158,14 +757,9 @@ void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
 
 		if (file.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
 			if (recursive)
-				FSUtil_fileSearchHelper(ret, path, exts, recursive);
-		} else {
-			for (string ext : exts) {
-				if (StringUtil::endsWith(path, ext)) {
-					ret.push_back(FSUtil::normalizePath(path));
-					break;
-				}
-			}
+				FSUtil_fileSearchHelper(ret, path, exts, recursive, directories);
+		} else if (exts.matches(path)) {
+			ret.push_back(FSUtil::normalizePath(path));
 		}
 	} while (FindNextFileA(findHndl, &file));
 
@@ -174,10 +768,12 @@ void FSUtil_fileSearchHelper(vector<string>& ret, const string& dir,
 #endif
 
 vector<string> FSUtil::searchForFiles(const string& dir, const vector<string>& exts,
-	bool recursive)
+	bool recursive, vector<string>* directories)
 {
+	TraceUtil::Span span("searchForFiles", "filesystem", {{"dir", dir},
+		{"extensions", StringUtil::join(exts, " ")}});
 	vector<string> ret;
-	FSUtil_fileSearchHelper(ret, dir, exts, recursive);
+	FSUtil_fileSearchHelper(ret, dir, FSUtil_ExtensionMatcher(exts), recursive, directories);
 	return ret;
 }
 
@@ -215,6 +811,7 @@ string FSUtil::which(const string& prog)
 #endif
 	}
 
+	std::lock_guard<std::mutex> guard(sFSUtil_whichLock);
 	if (fPATHs.empty()) {
 #ifdef _WIN32
 		fPATHs = StringUtil::split(OSUtil::getEnv("PATH"), ";");
@@ -225,6 +822,19 @@ string FSUtil::which(const string& prog)
 
 	if (fPATHs.empty())
 		return "";
+	if (!sFSUtil_whichStamped) {
+		sFSUtil_whichStamp = FSUtil_whichStamp(fPATHs);
+		sFSUtil_whichStamped = true;
+		if (!sFSUtil_whichStamp.empty() && sFSUtil_whichStamp == sFSUtil_savedWhichStamp)
+			sFSUtil_which.insert(sFSUtil_savedWhich.begin(), sFSUtil_savedWhich.end());
+		else if (!sFSUtil_savedWhich.empty())
+			sFSUtil_whichChanged = true;
+	}
+	std::map<string, string>::const_iterator it = sFSUtil_which.find(program);
+	if (it != sFSUtil_which.end())
+		return it->second;
+
+	string found;
 	for (string path : fPATHs) {
 		string fullPath =
 #ifdef _WIN32
@@ -232,99 +842,93 @@ string FSUtil::which(const string& prog)
 #else
 			combinePaths({path, program});
 #endif
-		if (isExec(fullPath))
-			return fullPath;
+		if (isExec(fullPath)) {
+			found = fullPath;
+			break;
+		}
 	}
-	return "";
+	sFSUtil_which.insert({program, found});
+	sFSUtil_whichChanged = true;
+	return found;
 }
 
 string FSUtil::normalizePath(const string& path)
 {
-	if (path.empty())
-		return path;
-
-	string ret = path;
-#ifdef _WIN32
-	StringUtil::replaceAll(ret, "\\", "/");
-#endif
-	vector<string> orig = StringUtil::split(ret, "/"), normd;
-	for (string i : orig) {
-		if (i == ".")
-			continue;
-		else if (i.empty() && normd.size() > 0) // preserve the opening '/'
-			continue;
-		else if (i == ".." && normd.size() > 0 && normd[normd.size() - 1] != "..")
-			normd.pop_back();
-		else
-			normd.push_back(i);
-	}
+	return Path(path).str();
+}
 
-	// Now that we've normalized the vector containing the individual components,
-	// rebuild the actual path string.
-	ret = "";
-	for (vector<string>::size_type i = 0; i < normd.size(); i++) {
-		if (i != 0)
-			ret += "/";
-		ret += normd[i];
-	}
+string FSUtil::combinePaths(const vector<string>& paths)
+{
+	Path ret;
+	for (const string& path : paths)
+		ret = ret.join(path);
+	return ret.str();
+}
 
-#ifdef _WIN32
-	// Turn Cygwin/MSYS-style paths (e.g. '/c/Windows/') into drive+path format
-	// (e.g. "C:/Windows/").
-	if (ret.length() > 2 && ret[0] == '/' && ret[2] == '/') {
-		ret[0] = ::toupper(ret[1]);
-		ret[1] = ':';
-	}
-#endif
-	return ret;
+string FSUtil::absolutePath(const string& path)
+{
+	return Path(path).absolute().str();
 }
 
-string FSUtil::combinePaths(const vector<string>& paths)
+// Whether normalizePath() would leave `path` as it is.
+static bool FSUtil_isNormalized(const string& path)
 {
-	string ret;
-	for (string path : paths) {
-		bool endsInSeparator =
-			ret.length() == 0 ||
-			StringUtil::endsWith(ret, "/")
+	if (path.empty())
+		return true;
+	string::size_type start = 0;
+	for (;;) {
+		const string::size_type end = std::min(path.find('/', start), path.length());
+		const string::size_type length = end - start;
+		if ((length == 0 && start != 0) || (length == 1 && path[start] == '.') ||
+				(length == 2 && path[start] == '.' && path[start + 1] == '.'))
+			return false;
 #ifdef _WIN32
-			|| StringUtil::endsWith(ret, "\\")
+		if (path.find('\\', start) < end)
+			return false;
 #endif
-			;
-
-		if (!endsInSeparator) {
-			ret += "/";
-		}
-		ret += path;
+		if (end == path.length())
+			return true;
+		start = end + 1;
 	}
-	return normalizePath(ret);
 }
 
-string FSUtil::absolutePath(const string& path)
+void FSUtil::absolutePaths(vector<string>& paths)
 {
-	string ret = normalizePath(path);
-	if (path[0] == '/'
-#ifdef _WIN32
-		|| (path.size() > 2 && path[1] == ':' && path[2] == '/')
-#endif
-		)
-		return ret;
-	char cwd[PATH_MAX];
-	if (getcwd(cwd, sizeof(cwd)) != NULL)
-		ret = FSUtil::combinePaths({cwd, path});
-	return ret;
+	const Path cwd = Path().absolute();
+	const string prefix = cwd.str() + "/";
+	for (string& path : paths) {
+		// The common case (e.g. what searchForFiles returns) just needs the
+		// working directory put in front.
+		if (cwd.empty() || path.empty() || isPathAbsolute(path) || !FSUtil_isNormalized(path))
+			path = absolutePath(path);
+		else
+			path.insert(0, prefix);
+	}
 }
 
 string FSUtil::parentDirectory(const string& path)
 {
-	string ret = normalizePath(path);
-	string::size_type pos = ret.rfind("/", ret.length() - 1 /* in case it ends with a '/' */);
-	if (pos == string::npos)
+	const Path parent = Path(path).parent();
+	if (parent.empty())
 		return "."; // No '/'s in the path; so it's just a single file.
-	return ret.substr(0, pos);
+	return parent.str();
+}
+
+bool FSUtil::chdir(const string& path)
+{
+#ifdef _MSC_VER
+	const bool ret = ::_chdir(path.c_str()) == 0;
+#else
+	const bool ret = ::chdir(path.c_str()) == 0;
+#endif
+	Path::workingDirectoryChanged();
+	clearMetadataCache(); // (Relative paths now mean something else.)
+	return ret;
 }
 
 void FSUtil::mkdir(const string& path)
 {
+	invalidateMetadata(path);
 #ifdef _MSC_VER
 	::_mkdir(path.c_str());
 #else
@@ -335,7 +939,110 @@ void FSUtil::mkdir(const string& path)
 		);
 #endif
 }
-void FSUtil::rmdir(const string& path)
+#ifndef _MSC_VER
+void FSUtil_removeHelper(const string& dir)
+{
+	DIR* dp = ::opendir(dir.c_str());
+	if (dp == nullptr)
+		return;
+
+	struct ::dirent* entry;
+	while ((entry = ::readdir(dp)) != nullptr) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+		string fullPath = dir + "/" + entry->d_name;
+		struct ::stat statbuf;
+#ifndef _WIN32
+		// Don't follow symlinks out of the directory we are removing.
+		if (::lstat(fullPath.c_str(), &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+#else
+		if (::stat(fullPath.c_str(), &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+#endif
+			FSUtil_removeHelper(fullPath);
+			::rmdir(fullPath.c_str());
+		} else
+			::remove(fullPath.c_str());
+	}
+
+	closedir(dp);
+}
+#else /* _MSC_VER */
+void FSUtil_removeHelper(const string& dir)
+{
+	WIN32_FIND_DATAA file;
+	HANDLE findHndl = nullptr;
+	if ((findHndl = FindFirstFileA((dir + "\\*").c_str(), &file)) == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		if (strcmp(file.cFileName, ".") == 0 || strcmp(file.cFileName, "..") == 0)
+			continue;
+		string path = dir + "\\" + file.cFileName;
+		if (file.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			FSUtil_removeHelper(path);
+			::_rmdir(path.c_str());
+		} else
+			::remove(path.c_str());
+	} while (FindNextFileA(findHndl, &file));
+
+	FindClose(findHndl);
+}
+#endif
+
+void FSUtil::rmdir(const string& path, bool recursive)
 {
+	if (recursive) {
+		FSUtil_removeHelper(path);
+		clearMetadataCache();
+	}
+	invalidateMetadata(path);
 	::rmdir(path.c_str());
 }
+
+string FSUtil::tempDirectory()
+{
+	// An explicitly set TMPDIR always wins; otherwise, prefer places which
+	// are usually memory-backed (tmpfs) over the disk-backed ones.
+	const char* vars[] = {"TMPDIR", "TMP", "TEMP", "XDG_RUNTIME_DIR"};
+	for (const char* var : vars) {
+		string dir = OSUtil::getEnv(var);
+		if (!dir.empty() && isDir(dir))
+			return normalizePath(dir);
+	}
+#ifndef _WIN32
+	if (isDir("/dev/shm") && ::access("/dev/shm", W_OK) == 0)
+		return "/dev/shm";
+	return "/tmp";
+#else
+	return ".";
+#endif
+}
+
+string FSUtil::mkdtemp(const string& prefix)
+{
+	string path = combinePaths({tempDirectory(), prefix + "-XXXXXX"});
+#ifndef _WIN32
+	vector<char> buf(path.begin(), path.end());
+	buf.push_back('\0');
+	if (::mkdtemp(buf.data()) == nullptr)
+		return "";
+	invalidateMetadata(buf.data());
+	return string(buf.data());
+#else
+	const string::size_type start = path.length() - 6;
+	for (int attempt = 0; attempt < 100; attempt++) {
+		for (string::size_type i = start; i < path.length(); i++)
+			path[i] = "abcdefghijklmnopqrstuvwxyz0123456789"[std::rand() % 36];
+#ifdef _MSC_VER
+		if (::_mkdir(path.c_str()) == 0)
+#else
+		if (::mkdir(path.c_str()) == 0)
+#endif
+		{
+			invalidateMetadata(path);
+			return path;
+		}
+	}
+	return "";
+#endif
+}
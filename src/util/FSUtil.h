@@ -4,34 +4,114 @@
  */
 #pragma once
 
+#include <cinttypes>
+#include <cstdio>
 #include <string>
 #include <vector>
 
 class FSUtil
 {
 public:
+	/*! These stat() each path only once; what FSUtil itself changes is taken
+	 * into account, but anything else (e.g. what a subprocess writes, or what
+	 * changes while `--watch` waits) needs invalidating. */
 	static bool exists(const std::string& path);
 	static bool isFile(const std::string& path);
 	static bool isDir(const std::string& path);
 	static bool isExec(const std::string& path);
 	static bool isPathAbsolute(const std::string& path);
+	static void invalidateMetadata(const std::string& path);
+	static void clearMetadataCache();
+	// How many of the above queries there were, and how many needed a stat().
+	static void metadataStatistics(uint64_t& queries, uint64_t& stats);
 
 	static std::string getContents(const std::string& file);
 	static bool setContents(const std::string& file, const std::string& contents);
+	/*! As setContents, but leaves the file (and its modification time) alone if
+	 * it already holds exactly `contents`, so nothing that depends on it has to
+	 * be redone. */
+	static bool setContentsIfChanged(const std::string& file, const std::string& contents);
+	// Sets the file's modification time to now, without changing it otherwise.
+	static bool touch(const std::string& file);
+
+	/*! Writes a file through a large buffer, into a temporary file next to it
+	 * (only created once the buffer first fills up) that replaces it, as
+	 * atomically as the OS allows, on commit(). If the writer is destroyed
+	 * without committing, the temporary file is removed again, and the file
+	 * stays as it was.
+	 *
+	 * Until what is written differs from what the file already holds, it is
+	 * only compared against that, and no temporary file is made; so if it
+	 * turns out to be the same, commit() leaves the file untouched. */
+	class AtomicWriter
+	{
+	public:
+		explicit AtomicWriter(const std::string& file, size_t bufferSize = 1 << 20);
+		~AtomicWriter();
+
+		void write(const std::string& data);
+		AtomicWriter& operator<<(const std::string& data) { write(data); return *this; }
+		/*! Writes out what is still buffered and closes the temporary file, but
+		 * doesn't replace the file yet, so that several can be committed
+		 * together; nothing can be written after this. False if writing failed. */
+		bool finish();
+		// False if writing has failed so far.
+		bool commit();
+		// After finish(): whether the file's contents are to change.
+		bool changed() const { return !fUnchanged; }
+
+	private:
+		AtomicWriter(const AtomicWriter&) = delete;
+		AtomicWriter& operator=(const AtomicWriter&) = delete;
+		void _flush();
+		bool _matchesExisting();
+		void _diverge();
+
+		std::string fFile, fTemporaryFile;
+		std::string fBuffer, fExistingBuffer;
+		size_t fBufferSize;
+		FILE* fExisting; // while what was written so far matches it
+		uint64_t fMatched;
+		FILE* fStream;
+		bool fTemporaryExists, fFinished, fUnchanged, fFailed;
+	};
 	static bool deleteFile(const std::string& file);
 
+	// `directories`, if given, gets every directory that was searched.
 	static std::vector<std::string> searchForFiles(const std::string& dir,
-		const std::vector<std::string>& exts, bool recursive);
+		const std::vector<std::string>& exts, bool recursive,
+		std::vector<std::string>* directories = nullptr);
+	/*! Listings of the directories searched are kept, and reused by later
+	 * searches for as long as the directories' modification times stay the
+	 * same. These carry them over from one run to the next. */
+	static bool loadDirectoryCache(const std::string& file);
+	static bool saveDirectoryCache(const std::string& file);
+	static void clearDirectoryCache();
+	/* How many threads a recursive search may list directories on; just the
+	 * calling one unless asked for more (`--parallel-search`.) */
+	static unsigned int sSearchJobs;
 
+	/*! Lookups in PATH are remembered, including ones that found nothing, until
+	 * clearMetadataCache(); the directory cache also carries them over to the
+	 * next run, where they are used if none of PATH's directories changed. */
 	static std::string which(const std::string& program);
 
 	static std::string normalizePath(const std::string& path);
 	static std::string combinePaths(const std::vector<std::string>& paths);
+	// Relative to the working directory, which is only looked up once (see chdir.)
 	static std::string absolutePath(const std::string& path);
+	// Makes every path in `paths` absolute (and normalized), in place.
+	static void absolutePaths(std::vector<std::string>& paths);
 	static std::string parentDirectory(const std::string& path);
 
+	// Changes the working directory, and what absolutePath() goes by.
+	static bool chdir(const std::string& dirname);
 	static void mkdir(const std::string& dirname);
-	static void rmdir(const std::string& dirname);
+	static void rmdir(const std::string& dirname, bool recursive = false);
+
+	static std::string tempDirectory();
+	// Creates a new, uniquely-named directory inside tempDirectory().
+	static std::string mkdtemp(const std::string& prefix);
 
 private:
 	static std::vector<std::string> fPATHs;
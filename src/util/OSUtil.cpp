@@ -8,6 +8,8 @@
 #include <cstdlib>
 #include <iostream>
 
+#include "TraceUtil.h"
+
 using std::string;
 
 #ifdef _MSC_VER
@@ -44,22 +46,62 @@ bool OSUtil::isFamilyUnix()
 #endif
 }
 
+struct OSUtil::PendingExec {
+	FILE* proc;
+
+	// For tracing
+	string program;
+	string command;
+	uint64_t start;
+	int track;
+};
+
 OSUtil::ExecResult OSUtil::exec(const string& program, const string& args, bool forwardOutput)
+{
+	return finishExec(execAsync(program, args), forwardOutput);
+}
+
+OSUtil::PendingExec* OSUtil::execAsync(const string& program, const string& args)
 {
 	string cmd = "\"" + program + "\"" + " " + args + " 2>&1";
 #ifdef _WIN32
 	cmd = "\"" + cmd + "\"";
 #endif
 
+	PendingExec* pending = new PendingExec;
+	pending->proc = ::popen(cmd.c_str(), "r");
+	if (TraceUtil::enabled()) {
+		pending->program = program;
+		pending->command = cmd;
+		pending->start = TraceUtil::now();
+		pending->track = TraceUtil::acquireTrack();
+	}
+	return pending;
+}
+
+OSUtil::ExecResult OSUtil::finishExec(PendingExec* pending, bool forwardOutput)
+{
 	ExecResult ret;
-	FILE* proc = ::popen(cmd.c_str(), "r");
-	char buf[256];
-	while (fgets(buf, sizeof(buf), proc) != 0) {
-		ret.output.append(buf);
-		if (forwardOutput)
-			std::cout << buf << std::flush;
+	FILE* proc = pending->proc;
+	if (proc == nullptr) {
+		ret.exitcode = -1;
+	} else {
+		char buf[256];
+		while (fgets(buf, sizeof(buf), proc) != 0) {
+			ret.output.append(buf);
+			if (forwardOutput)
+				std::cout << buf << std::flush;
+		}
+		ret.exitcode = ::pclose(proc);
+	}
+
+	if (TraceUtil::enabled()) {
+		TraceUtil::span(pending->program, "process", pending->start,
+			{{"command", pending->command}, {"exitcode", std::to_string(ret.exitcode)}},
+			pending->track);
+		TraceUtil::releaseTrack(pending->track);
 	}
-	ret.exitcode = ::pclose(proc);
+	delete pending;
 	return ret;
 }
 
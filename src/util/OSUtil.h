@@ -20,5 +20,11 @@ public:
 	static ExecResult exec(const std::string& program, const std::string& args,
 		bool forwardOutput = false);
 
+	// Starts the program in the background; its result must be collected
+	// with finishExec(), which also frees the PendingExec.
+	struct PendingExec;
+	static PendingExec* execAsync(const std::string& program, const std::string& args);
+	static ExecResult finishExec(PendingExec* pending, bool forwardOutput = false);
+
 	static std::string getEnv(const std::string& env);
 };
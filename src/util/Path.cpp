@@ -0,0 +1,387 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "Path.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <cctype>
+#include <climits>
+#include <cstring>
+
+#ifndef _MSC_VER
+#  include <unistd.h>
+#else /* _MSC_VER */
+#  include <direct.h>
+#  define getcwd _getcwd
+#  define PATH_MAX 260
+#endif
+
+using std::string;
+using std::vector;
+
+namespace {
+
+/* An open-addressed hash set of ids (with 0 marking empty slots), which
+ * doesn't store what they are hashed by, so it takes 4 bytes or so per id;
+ * what an id stands for has to be looked up to compare or rehash it. */
+class Path_IdSet
+{
+public:
+	Path_IdSet() : fSlots(1024, 0), fCount(0) {}
+
+	// The slot holding the id `equals` accepts, or the empty one it would go in.
+	template<typename Equals>
+	uint32_t& find(size_t hash, const Equals& equals)
+	{
+		const size_t mask = fSlots.size() - 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+			if (fSlots[i] == 0 || equals(fSlots[i]))
+				return fSlots[i];
+		}
+	}
+
+	// `slot` must have come from find(), with nothing inserted since.
+	template<typename HashOf>
+	void insert(uint32_t& slot, uint32_t id, const HashOf& hashOf)
+	{
+		slot = id;
+		if (++fCount * 4 < fSlots.size() * 3)
+			return;
+		vector<uint32_t> old(fSlots.size() * 2, 0);
+		old.swap(fSlots);
+		const size_t mask = fSlots.size() - 1;
+		for (uint32_t existing : old) {
+			if (existing == 0)
+				continue;
+			size_t i = hashOf(existing) & mask;
+			while (fSlots[i] != 0)
+				i = (i + 1) & mask;
+			fSlots[i] = existing;
+		}
+	}
+
+	size_t bytes() const { return fSlots.capacity() * sizeof(uint32_t); }
+
+private:
+	vector<uint32_t> fSlots;
+	size_t fCount;
+};
+
+struct Path_Node {
+	uint32_t parent;
+	uint32_t component; // with kPath_absolute set if the path is absolute
+};
+const uint32_t kPath_absolute = 0x80000000u;
+
+// Component 0 is unused (so that ids are never 0); 1 is the empty one, which
+// starts absolute paths, and 2 is "..".
+const uint32_t kPath_root = 1, kPath_up = 2;
+
+// Everything is done with `lock` held.
+struct Path_Table {
+	std::mutex lock;
+	vector<Path_Node> nodes;
+	// The components' characters, one after the other; component `i` is
+	// from offsets[i] to offsets[i + 1].
+	vector<char> characters;
+	vector<uint32_t> offsets;
+	Path_IdSet componentIds;
+	Path_IdSet children;
+	std::unordered_map<uint32_t, uint32_t> absolutes; // of relative paths
+	uint32_t cwd;
+	bool cwdKnown;
+
+	Path_Table()
+		:
+		cwd(0),
+		cwdKnown(false)
+	{
+		nodes.push_back({0, 0}); // the empty path
+		offsets.push_back(0);
+		offsets.push_back(0); // the unused component
+		intern("", 0);
+		intern("..", 2);
+	}
+
+	static size_t hashOf(const char* chars, size_t length)
+	{
+		// 64-bit FNV-1a, as StringUtil::hash.
+		uint64_t ret = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; i++) {
+			ret ^= (unsigned char)chars[i];
+			ret *= 1099511628211ULL;
+		}
+		return ret ^ (ret >> 32);
+	}
+	static size_t hashOf(uint32_t parent, uint32_t component)
+	{
+		const uint64_t key = ((uint64_t(parent) << 32) | component) * 0x9E3779B97F4A7C15ULL;
+		return key ^ (key >> 32);
+	}
+
+	const char* componentChars(uint32_t id) const { return characters.data() + offsets[id]; }
+	size_t componentLength(uint32_t id) const { return offsets[id + 1] - offsets[id]; }
+	uint32_t componentOf(uint32_t node) const { return nodes[node].component & ~kPath_absolute; }
+
+	uint32_t intern(const char* chars, size_t length)
+	{
+		const size_t hash = hashOf(chars, length);
+		uint32_t& slot = componentIds.find(hash, [&](uint32_t id) {
+			return componentLength(id) == length && memcmp(componentChars(id), chars, length) == 0;
+		});
+		if (slot != 0)
+			return slot;
+		const uint32_t id = offsets.size() - 1;
+		characters.insert(characters.end(), chars, chars + length);
+		offsets.push_back(characters.size());
+		componentIds.insert(slot, id, [&](uint32_t existing) {
+			return hashOf(componentChars(existing), componentLength(existing));
+		});
+		return id;
+	}
+
+	static bool isAbsoluteRoot(const char* chars, size_t length)
+	{
+#ifdef _WIN32
+		if (length == 2 && chars[1] == ':')
+			return true;
+#endif
+		(void)chars;
+		return length == 0;
+	}
+
+	// Appends a component to `node` the way FSUtil::normalizePath always has.
+	uint32_t child(uint32_t node, const char* chars, size_t length)
+	{
+		if (length == 1 && chars[0] == '.')
+			return node;
+		if (node != 0) {
+			if (length == 0) // preserve only the opening '/'
+				return node;
+			if (length == 2 && chars[0] == '.' && chars[1] == '.' && componentOf(node) != kPath_up)
+				return nodes[node].parent;
+		}
+
+		const uint32_t component = intern(chars, length);
+		uint32_t& slot = children.find(hashOf(node, component), [&](uint32_t id) {
+			return nodes[id].parent == node && componentOf(id) == component;
+		});
+		if (slot != 0)
+			return slot;
+		const bool absolute = (node == 0) ? isAbsoluteRoot(chars, length)
+			: (nodes[node].component & kPath_absolute) != 0;
+		const uint32_t id = nodes.size();
+		nodes.push_back({node, component | (absolute ? kPath_absolute : 0)});
+		children.insert(slot, id, [&](uint32_t existing) {
+			return hashOf(nodes[existing].parent, componentOf(existing));
+		});
+		return id;
+	}
+
+	uint32_t parse(uint32_t node, const string& path)
+	{
+		const char* chars = path.c_str();
+		string::size_type start = 0, end;
+		while ((end = path.find('/', start)) != string::npos) {
+			node = child(node, chars + start, end - start);
+			start = end + 1;
+		}
+		node = child(node, chars + start, path.length() - start);
+#ifdef _WIN32
+		node = driveForm(node);
+#endif
+		return node;
+	}
+
+	// The components of `node`, from the outermost.
+	void componentsOf(uint32_t node, vector<uint32_t>& result) const
+	{
+		result.clear();
+		for (; node != 0; node = nodes[node].parent)
+			result.push_back(componentOf(node));
+		std::reverse(result.begin(), result.end());
+	}
+
+	uint32_t join(uint32_t node, uint32_t relative)
+	{
+		if (node == 0)
+			return relative;
+		vector<uint32_t> parts;
+		componentsOf(relative, parts);
+		for (uint32_t component : parts)
+			node = child(node, componentChars(component), componentLength(component));
+		return node;
+	}
+
+	string str(uint32_t node) const
+	{
+		vector<uint32_t> parts;
+		componentsOf(node, parts);
+		string::size_type length = 0;
+		for (uint32_t component : parts)
+			length += componentLength(component) + 1;
+		string ret;
+		ret.reserve(length);
+		for (vector<uint32_t>::size_type i = 0; i < parts.size(); i++) {
+			if (i != 0)
+				ret += '/';
+			ret.append(componentChars(parts[i]), componentLength(parts[i]));
+		}
+		return ret;
+	}
+
+#ifdef _WIN32
+	// Turns Cygwin/MSYS-style paths (e.g. '/c/Windows/') into drive+path format
+	// (e.g. "C:/Windows/").
+	uint32_t driveForm(uint32_t node)
+	{
+		vector<uint32_t> parts;
+		componentsOf(node, parts);
+		if (parts.size() < 3 || parts[0] != kPath_root || componentLength(parts[1]) != 1)
+			return node;
+		const char drive[2] = {(char)::toupper(componentChars(parts[1])[0]), ':'};
+		node = child(0, drive, 2);
+		for (vector<uint32_t>::size_type i = 2; i < parts.size(); i++)
+			node = child(node, componentChars(parts[i]), componentLength(parts[i]));
+		return node;
+	}
+#endif
+
+	uint32_t workingDirectory()
+	{
+		if (!cwdKnown) {
+			char buffer[PATH_MAX];
+			if (getcwd(buffer, sizeof(buffer)) != NULL) {
+				string path = buffer;
+#ifdef _WIN32
+				std::replace(path.begin(), path.end(), '\\', '/');
+#endif
+				cwd = parse(0, path);
+			}
+			cwdKnown = true;
+		}
+		return cwd;
+	}
+};
+
+Path_Table& Path_table()
+{
+	static Path_Table table;
+	return table;
+}
+
+}
+
+Path::Path(const string& path)
+	:
+	fNode(0)
+{
+	if (path.empty())
+		return;
+	Path_Table& table = Path_table();
+#ifdef _WIN32
+	string forward = path;
+	std::replace(forward.begin(), forward.end(), '\\', '/');
+	std::lock_guard<std::mutex> guard(table.lock);
+	fNode = table.parse(0, forward);
+#else
+	std::lock_guard<std::mutex> guard(table.lock);
+	fNode = table.parse(0, path);
+#endif
+}
+
+bool Path::isAbsolute() const
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	return (table.nodes[fNode].component & kPath_absolute) != 0;
+}
+
+Path Path::parent() const
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	return Path(table.nodes[fNode].parent);
+}
+
+string Path::name() const
+{
+	if (fNode == 0)
+		return string();
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	const uint32_t component = table.componentOf(fNode);
+	return string(table.componentChars(component), table.componentLength(component));
+}
+
+Path Path::join(const string& relative) const
+{
+	if (relative.empty())
+		return *this;
+	Path_Table& table = Path_table();
+#ifdef _WIN32
+	string forward = relative;
+	std::replace(forward.begin(), forward.end(), '\\', '/');
+	std::lock_guard<std::mutex> guard(table.lock);
+	return Path(table.parse(fNode, forward));
+#else
+	std::lock_guard<std::mutex> guard(table.lock);
+	return Path(table.parse(fNode, relative));
+#endif
+}
+
+Path Path::join(const Path& relative) const
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	return Path(table.join(fNode, relative.fNode));
+}
+
+Path Path::absolute() const
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	if ((table.nodes[fNode].component & kPath_absolute) != 0)
+		return *this;
+	std::unordered_map<uint32_t, uint32_t>::const_iterator it = table.absolutes.find(fNode);
+	if (it != table.absolutes.end())
+		return Path(it->second);
+	// If the working directory can't be had, this stays relative.
+	const uint32_t absolute = table.join(table.workingDirectory(), fNode);
+	table.absolutes.insert({fNode, absolute});
+	return Path(absolute);
+}
+
+string Path::str() const
+{
+	if (fNode == 0)
+		return string();
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	return table.str(fNode);
+}
+
+void Path::workingDirectoryChanged()
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	table.cwdKnown = false;
+	table.absolutes.clear();
+}
+
+void Path::statistics(size_t& paths, size_t& components, size_t& bytes)
+{
+	Path_Table& table = Path_table();
+	std::lock_guard<std::mutex> guard(table.lock);
+	paths = table.nodes.size() - 1;
+	components = table.offsets.size() - 2;
+	bytes = table.nodes.capacity() * sizeof(Path_Node) +
+		table.characters.capacity() + table.offsets.capacity() * sizeof(uint32_t) +
+		table.componentIds.bytes() + table.children.bytes() +
+		table.absolutes.size() * (sizeof(void*) * 3 + sizeof(uint32_t) * 2);
+}
@@ -0,0 +1,65 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/*! A normalized path, interned: every distinct path is stored once, as its
+ * last component (itself interned) and a reference to its parent, so a Path
+ * is just an index. Paths are normalized when they are made, the same way
+ * FSUtil::normalizePath does (which uses this); after that, parent() and
+ * join() are table lookups, and comparing two Paths compares two integers.
+ *
+ * Safe to use from multiple threads. Paths are never freed. */
+class Path
+{
+public:
+	Path() : fNode(0) {}
+	explicit Path(const std::string& path);
+
+	bool empty() const { return fNode == 0; }
+	bool isAbsolute() const;
+
+	// The path without its last component (which may be empty.)
+	Path parent() const;
+	// The last component.
+	std::string name() const;
+	// As FSUtil::combinePaths would: leading separators in `relative` are ignored.
+	Path join(const std::string& relative) const;
+	Path join(const Path& relative) const;
+	// This, relative to the current directory if it isn't absolute; cached.
+	Path absolute() const;
+
+	std::string str() const;
+
+	bool operator==(const Path& other) const { return fNode == other.fNode; }
+	bool operator!=(const Path& other) const { return fNode != other.fNode; }
+	// An arbitrary (but consistent) order, e.g. for std::set.
+	bool operator<(const Path& other) const { return fNode < other.fNode; }
+	size_t hash() const { return fNode; }
+
+	/*! Forgets the working directory absolute() uses (which is otherwise only
+	 * looked up once), and the absolute forms of relative paths with it. Called
+	 * by FSUtil::chdir. */
+	static void workingDirectoryChanged();
+
+	// How many paths and distinct components are interned, and roughly how
+	// many bytes that takes.
+	static void statistics(size_t& paths, size_t& components, size_t& bytes);
+
+private:
+	explicit Path(uint32_t node) : fNode(node) {}
+
+	uint32_t fNode;
+};
+
+namespace std {
+template<> struct hash<Path> {
+	size_t operator()(const Path& path) const { return path.hash(); }
+};
+}
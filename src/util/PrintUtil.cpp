@@ -7,10 +7,13 @@
 #include <iostream>
 
 #include "TermUtil.h"
+#include "TraceUtil.h"
 
 using std::string;
 
 bool PrintUtil::sChecking = false;
+string PrintUtil::sCheckingWhat;
+uint64_t PrintUtil::sCheckingStart = 0;
 
 void PrintUtil::error(const string& str)
 {
@@ -36,11 +39,17 @@ void PrintUtil::message(const string& str)
 void PrintUtil::checking(const string& str)
 {
 	sChecking = true;
+	if (TraceUtil::enabled()) {
+		sCheckingWhat = str;
+		sCheckingStart = TraceUtil::now();
+	}
 	std::cout << "checking " << str << "... " << std::flush;
 }
 void PrintUtil::checkFinished(const string& str, int status)
 {
 	sChecking = false;
+	if (TraceUtil::enabled())
+		TraceUtil::span("checking " + sCheckingWhat, "probe", sCheckingStart, {{"result", str}});
 	if (status == 0)
 		TermUtil::setColor(TermUtil::Red);
 	else if (status == 1)
@@ -4,6 +4,7 @@
  */
 #pragma once
 
+#include <cinttypes>
 #include <string>
 
 class PrintUtil
@@ -19,4 +20,6 @@ public:
 
 private:
 	static bool sChecking;
+	static std::string sCheckingWhat;
+	static uint64_t sCheckingStart;
 };
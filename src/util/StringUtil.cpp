@@ -4,6 +4,9 @@
  */
 #include "StringUtil.h"
 
+#include <algorithm>
+#include <cstring>
+
 using std::string;
 using std::vector;
 
@@ -24,22 +27,26 @@ int StringUtil::count(const string& str, const string& thing)
 
 vector<string> StringUtil::split(const string& str, const string& delimiter)
 {
-	vector<string> ret(count(str, delimiter) + 1);
-
-	size_t next = 0, oldPos = 0, newPos = 0, length = delimiter.length();
-	while ((newPos = str.find(delimiter, oldPos)) != string::npos) {
-		ret[next++] = str.substr(oldPos, newPos - oldPos);
-		oldPos = newPos + length;
-	}
-	ret[next++] = str.substr(oldPos);
-
+	vector<string> ret;
+	for (SplitIterator it(str, delimiter); it.next(); )
+		ret.push_back(it.str());
 	return ret;
 }
 
 string StringUtil::join(const vector<string>& array, const string& delimiter,
 	bool skipEmptyStrings)
 {
-	string ret = "";
+	// Work out how long it will be first, so it's only allocated once.
+	string::size_type length = 0;
+	for (vector<string>::size_type i = 0; i < array.size(); i++) {
+		if (skipEmptyStrings && array[i].empty())
+			continue;
+		if (i != 0)
+			length += delimiter.length();
+		length += array[i].length();
+	}
+	string ret;
+	ret.reserve(length);
 	for (vector<string>::size_type i = 0; i < array.size(); i++) {
 		if (skipEmptyStrings && array[i].empty())
 			continue;
@@ -50,6 +57,33 @@ string StringUtil::join(const vector<string>& array, const string& delimiter,
 	return ret;
 }
 
+StringUtil::SplitIterator::SplitIterator(const string& str, const string& delimiter)
+	:
+	fString(str),
+	fDelimiter(delimiter),
+	fStart(0),
+	fEnd(0),
+	fNext(0)
+{
+}
+
+bool StringUtil::SplitIterator::next()
+{
+	if (fNext == string::npos)
+		return false;
+	fStart = fNext;
+	const string::size_type found = fDelimiter.empty() ? string::npos :
+		fString.find(fDelimiter, fStart);
+	if (found == string::npos) {
+		fEnd = fString.length();
+		fNext = string::npos;
+	} else {
+		fEnd = found;
+		fNext = found + fDelimiter.length();
+	}
+	return true;
+}
+
 string StringUtil::trim(const string& str)
 {
 	string::size_type from = 0;
@@ -87,9 +121,134 @@ bool StringUtil::endsWith(const string& haystack, const string& needle)
 
 void StringUtil::replaceAll(string& subject, const string& search, const string& replace)
 {
-	size_t pos = 0, searchLen = search.length();
-	while ((pos = subject.find(search, pos)) != string::npos) {
-		subject.replace(pos, searchLen, replace);
-		pos += replace.length();
+	// Build the result alongside, rather than replacing in place (which moves
+	// the rest of the string every time.)
+	const size_t searchLen = search.length();
+	size_t pos = searchLen == 0 ? string::npos : subject.find(search);
+	if (pos == string::npos)
+		return;
+	string ret;
+	ret.reserve(subject.length());
+	size_t from = 0;
+	do {
+		ret.append(subject, from, pos - from);
+		ret += replace;
+		from = pos + searchLen;
+	} while ((pos = subject.find(search, from)) != string::npos);
+	ret.append(subject, from, string::npos);
+	subject.swap(ret);
+}
+
+string StringUtil::replaceEach(const string& subject,
+	const vector<std::pair<string, string> >& replacements)
+{
+	// Only positions holding the first character of some pattern need checking.
+	bool firsts[256] = {false};
+	for (const std::pair<string, string>& replacement : replacements) {
+		if (!replacement.first.empty())
+			firsts[(unsigned char)replacement.first[0]] = true;
+	}
+
+	const char* data = subject.data();
+	const size_t length = subject.length();
+	string ret;
+	ret.reserve(length);
+	size_t from = 0;
+	for (size_t i = 0; i < length; ) {
+		if (!firsts[(unsigned char)data[i]]) {
+			i++;
+			continue;
+		}
+		bool replaced = false;
+		for (const std::pair<string, string>& replacement : replacements) {
+			const string& search = replacement.first;
+			if (search.empty() || search.length() > length - i ||
+					memcmp(data + i, search.data(), search.length()) != 0)
+				continue;
+			ret.append(data + from, i - from);
+			ret += replacement.second;
+			i += search.length();
+			from = i;
+			replaced = true;
+			break;
+		}
+		if (!replaced)
+			i++;
+	}
+	ret.append(data + from, length - from);
+	return ret;
+}
+
+StringUtil::Escaper::Escaper(const vector<std::pair<char, string> >& escapes)
+	:
+	fPatternCount(0)
+{
+	for (bool& escaped : fEscaped)
+		escaped = false;
+	for (const std::pair<char, string>& escape : escapes) {
+		fEscapes[(unsigned char)escape.first] = escape.second;
+		fEscaped[(unsigned char)escape.first] = true;
+	}
+	for (int c = 0; c < 256; c++) {
+		if (!fEscaped[c])
+			continue;
+		if (fPatternCount == 8) {
+			fPatternCount = 0;
+			break;
+		}
+		fPatterns[fPatternCount++] = 0x0101010101010101ULL * c;
 	}
 }
+
+bool StringUtil::Escaper::_anyIn(const char* eight) const
+{
+	uint64_t word;
+	memcpy(&word, eight, sizeof(word));
+	uint64_t found = 0;
+	for (size_t i = 0; i < fPatternCount; i++) {
+		// A byte of `difference` is 0 where the character is; this sets the
+		// high bit of (at least) the first such byte.
+		const uint64_t difference = word ^ fPatterns[i];
+		found |= (difference - 0x0101010101010101ULL) & ~difference & 0x8080808080808080ULL;
+	}
+	return found != 0;
+}
+
+void StringUtil::Escaper::append(string& out, const string& str) const
+{
+	const char* data = str.data();
+	const size_t length = str.length();
+	size_t from = 0, i = 0;
+	while (i < length) {
+		if (fPatternCount != 0) {
+			while (i + 8 <= length && !_anyIn(data + i))
+				i += 8;
+		}
+		const size_t end = std::min(i + 8, length);
+		while (i < end && !fEscaped[(unsigned char)data[i]])
+			i++;
+		if (i == end)
+			continue;
+		out.append(data + from, i - from);
+		out += fEscapes[(unsigned char)data[i]];
+		from = ++i;
+	}
+	out.append(data + from, length - from);
+}
+
+string StringUtil::Escaper::operator()(const string& str) const
+{
+	string ret;
+	append(ret, str);
+	return ret;
+}
+
+uint64_t StringUtil::hash(const string& str)
+{
+	uint64_t ret = 14695981039346656037ULL;
+	for (string::size_type i = 0; i < str.length(); i++) {
+		ret ^= (unsigned char)str[i];
+		ret *= 1099511628211ULL;
+	}
+	return ret;
+}
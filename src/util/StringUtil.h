@@ -4,7 +4,9 @@
  */
 #pragma once
 
+#include <cinttypes>
 #include <string>
+#include <utility>
 #include <vector>
 
 class StringUtil
@@ -16,6 +18,34 @@ public:
 	static std::string join(const std::vector<std::string>& array,
 		const std::string& delimiter, bool skipEmptyStrings = true);
 
+	/*! Goes through the pieces split() would return, without copying them:
+	 *     for (StringUtil::SplitIterator it(str, ":"); it.next(); )
+	 *         ... it.data(), it.length() ...
+	 * `str` must outlive the iterator. */
+	class SplitIterator
+	{
+	public:
+		SplitIterator(const std::string& str, const std::string& delimiter);
+		SplitIterator(std::string&& str, const std::string& delimiter) = delete;
+		// Moves to the next piece; false once there are none left.
+		bool next();
+
+		const char* data() const { return fString.data() + fStart; }
+		std::string::size_type position() const { return fStart; }
+		std::string::size_type length() const { return fEnd - fStart; }
+		bool empty() const { return fEnd == fStart; }
+		bool operator==(const std::string& other) const
+			{ return fString.compare(fStart, fEnd - fStart, other) == 0; }
+		bool operator!=(const std::string& other) const { return !(*this == other); }
+		std::string str() const { return fString.substr(fStart, fEnd - fStart); }
+
+	private:
+		const std::string& fString;
+		const std::string fDelimiter;
+		std::string::size_type fStart, fEnd;
+		std::string::size_type fNext; // npos after the last piece
+	};
+
 	static std::string trim(const std::string& str);
 
 	static bool startsWith(const std::string& haystack, const std::string& needle);
@@ -23,4 +53,33 @@ public:
 
 	static void replaceAll(std::string& subject,
 		const std::string& search, const std::string& replace);
+	/*! Replaces every occurrence of any of the patterns, in one pass: at each
+	 * position, the first one (in order) that matches there is replaced, and
+	 * the search goes on after it, so replacements are never replaced again. */
+	static std::string replaceEach(const std::string& subject,
+		const std::vector<std::pair<std::string, std::string> >& replacements);
+
+	/*! Escapes single characters, each by a string of its own, appending the
+	 * result straight to an output buffer. Where there are 8 or fewer
+	 * characters to escape, runs without any are skipped 8 bytes at a time
+	 * (comparing all 8 with each character at once, in a 64-bit word.) */
+	class Escaper
+	{
+	public:
+		Escaper(const std::vector<std::pair<char, std::string> >& escapes);
+
+		void append(std::string& out, const std::string& str) const;
+		std::string operator()(const std::string& str) const;
+
+	private:
+		inline bool _anyIn(const char* eight) const;
+
+		std::string fEscapes[256];
+		bool fEscaped[256];
+		uint64_t fPatterns[8]; // each character, repeated in every byte
+		size_t fPatternCount; // 0 if there are too many for that
+	};
+
+	// 64-bit FNV-1a; stable across platforms and runs, so it can be stored.
+	static uint64_t hash(const std::string& str);
 };
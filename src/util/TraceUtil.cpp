@@ -0,0 +1,152 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "TraceUtil.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+#include "FSUtil.h"
+#include "StringUtil.h"
+
+using std::string;
+
+bool TraceUtil::sEnabled = false;
+string TraceUtil::sOutputFile;
+std::vector<string> TraceUtil::sEvents;
+std::vector<bool> TraceUtil::sTracksInUse;
+
+static std::chrono::steady_clock::time_point sTraceStart;
+// Guards sEvents and sTracksInUse, for spans recorded on other threads.
+static std::mutex sTraceUtil_lock;
+static thread_local int sTraceUtil_currentTrack = TraceUtil::kMainTrack;
+
+void TraceUtil::enable(const string& outputFile)
+{
+	sEnabled = true;
+	sOutputFile = outputFile;
+	sTraceStart = std::chrono::steady_clock::now();
+	sTracksInUse.assign(kMainTrack + 1, true);
+	sEvents.push_back("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " +
+		std::to_string(kMainTrack) + ", \"args\": {\"name\": \"phoenix\"}}");
+}
+
+bool TraceUtil::write()
+{
+	if (!sEnabled)
+		return true;
+	std::lock_guard<std::mutex> guard(sTraceUtil_lock);
+	return FSUtil::setContents(sOutputFile, "{\"traceEvents\": [\n" +
+		StringUtil::join(sEvents, ",\n") + "\n]}\n");
+}
+
+uint64_t TraceUtil::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - sTraceStart).count();
+}
+
+void TraceUtil::span(const string& name, const string& category, uint64_t start,
+	const Args& args, int track)
+{
+	if (!sEnabled)
+		return;
+
+	string event = "{\"name\": " + escape(name) + ", \"cat\": " + escape(category) +
+		", \"ph\": \"X\", \"ts\": " + std::to_string(start) +
+		", \"dur\": " + std::to_string(now() - start) +
+		", \"pid\": 1, \"tid\": " + std::to_string(track);
+	if (!args.empty()) {
+		event += ", \"args\": {";
+		for (Args::const_iterator it = args.begin(); it != args.end(); it++) {
+			if (it != args.begin())
+				event += ", ";
+			event += escape(it->first) + ": " + escape(it->second);
+		}
+		event += "}";
+	}
+	std::lock_guard<std::mutex> guard(sTraceUtil_lock);
+	sEvents.push_back(event + "}");
+}
+
+int TraceUtil::acquireTrack()
+{
+	if (!sEnabled)
+		return kMainTrack;
+	std::lock_guard<std::mutex> guard(sTraceUtil_lock);
+	for (std::vector<bool>::size_type i = kMainTrack + 1; i < sTracksInUse.size(); i++) {
+		if (!sTracksInUse[i]) {
+			sTracksInUse[i] = true;
+			return i;
+		}
+	}
+	const int track = sTracksInUse.size();
+	sTracksInUse.push_back(true);
+	sEvents.push_back("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " +
+		std::to_string(track) + ", \"args\": {\"name\": \"background " +
+		std::to_string(track - kMainTrack) + "\"}}");
+	return track;
+}
+
+void TraceUtil::releaseTrack(int track)
+{
+	std::lock_guard<std::mutex> guard(sTraceUtil_lock);
+	if (track > kMainTrack && track < (int)sTracksInUse.size())
+		sTracksInUse[track] = false;
+}
+
+int TraceUtil::currentTrack()
+{
+	return sTraceUtil_currentTrack;
+}
+
+void TraceUtil::setCurrentTrack(int track)
+{
+	sTraceUtil_currentTrack = track;
+}
+
+string TraceUtil::escape(const string& str)
+{
+	string ret = "\"";
+	for (string::size_type i = 0; i < str.size(); i++) {
+		const unsigned char c = str[i];
+		switch (c) {
+		case '"': ret += "\\\""; break;
+		case '\\': ret += "\\\\"; break;
+		case '\n': ret += "\\n"; break;
+		case '\r': ret += "\\r"; break;
+		case '\t': ret += "\\t"; break;
+		default:
+			if (c < 0x20) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", c);
+				ret += buf;
+			} else
+				ret += c;
+		break;
+		}
+	}
+	return ret + "\"";
+}
+
+TraceUtil::Span::Span(const string& name, const string& category, const Args& args)
+	:
+	fStart(0),
+	fTrack(kMainTrack)
+{
+	if (!sEnabled)
+		return;
+	fName = name;
+	fCategory = category;
+	fArgs = args;
+	fStart = now();
+	fTrack = currentTrack();
+}
+
+TraceUtil::Span::~Span()
+{
+	if (sEnabled)
+		span(fName, fCategory, fStart, fArgs, fTrack);
+}
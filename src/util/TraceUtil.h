@@ -0,0 +1,60 @@
+/*
+ * (C) 2015-2017 Augustin Cavalier
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#pragma once
+
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <vector>
+
+// Records spans in the Chrome trace-event format (loadable in Perfetto or
+// chrome://tracing.) Everything is a no-op until enable() is called.
+class TraceUtil
+{
+public:
+	typedef std::map<std::string, std::string> Args;
+
+	static void enable(const std::string& outputFile);
+	static inline bool enabled() { return sEnabled; }
+	static bool write();
+
+	// Tracks are what the trace viewer shows as threads. Work that runs in the
+	// background (e.g. subprocesses) gets a track of its own while it runs.
+	static const int kMainTrack = 1;
+	static int acquireTrack();
+	static void releaseTrack(int track);
+	// The track spans recorded on the calling thread go on by default.
+	static int currentTrack();
+	static void setCurrentTrack(int track);
+
+	// Microseconds since enable() was called. Recording is thread-safe.
+	static uint64_t now();
+	static void span(const std::string& name, const std::string& category,
+		uint64_t start, const Args& args = Args(), int track = currentTrack());
+
+	// Records a span from its construction until its destruction.
+	class Span
+	{
+	public:
+		Span(const std::string& name, const std::string& category,
+			const Args& args = Args());
+		~Span();
+
+	private:
+		std::string fName;
+		std::string fCategory;
+		Args fArgs;
+		uint64_t fStart;
+		int fTrack;
+	};
+
+private:
+	static std::string escape(const std::string& str);
+
+	static bool sEnabled;
+	static std::string sOutputFile;
+	static std::vector<std::string> sEvents;
+	static std::vector<bool> sTracksInUse;
+};
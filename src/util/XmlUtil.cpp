@@ -8,6 +8,9 @@
 
 using std::string;
 
+static const StringUtil::Escaper kXmlUtil_escaper({{'&', "&amp;"}, {'<', "&lt;"}, {'>', "&gt;"},
+	{'"', "&quot;"}, {'\'', "&apos;"}, {'\t', "&#9;"}, {'\n', "&#10;"}, {'\r', "&#13;"}});
+
 XmlGenerator::XmlGenerator(const string& rootTagName,
 	std::map<string, string> rootTagAttrs, bool pretty)
 	:
@@ -30,7 +33,9 @@ void XmlGenerator::beginTag(const string& tagName, std::map<string, string> tagA
 	fHierarchy.push_back(tagName);
 	fBuffer += "<" + tagName;
 	for (_tagmap::const_iterator it = tagAttrs.begin(); it != tagAttrs.end(); it++) {
-		fBuffer += " " + it->first + "=\"" + escape(it->second) + "\"";
+		fBuffer += " " + it->first + "=\"";
+		kXmlUtil_escaper.append(fBuffer, it->second);
+		fBuffer += "\"";
 	}
 	if (oneliner) {
 		fBuffer += "/>";
@@ -59,12 +64,7 @@ string XmlGenerator::finish()
 
 string XmlGenerator::escape(const string& str)
 {
-	string ret = str;
-	StringUtil::replaceAll(ret, "&", "&amp;");
-	StringUtil::replaceAll(ret, "<", "&lt;");
-	StringUtil::replaceAll(ret, ">", "&gt;");
-	StringUtil::replaceAll(ret, "\"", "&quot;");
-	return ret;
+	return kXmlUtil_escaper(str);
 }
 
 void XmlGenerator::indents()
@@ -23,12 +23,14 @@ public:
 
 	std::string finish();
 
+	// For attribute values (including whitespace other than spaces.)
+	static std::string escape(const std::string& str);
+
 private:
 	std::string fBuffer;
 	std::vector<std::string> fHierarchy;
 	bool fPretty;
 
-	std::string escape(const std::string& str);
 	void indents();
 	inline void newline() { if (fPretty) fBuffer += "\n"; }
 };
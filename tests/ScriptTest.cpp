@@ -5,7 +5,24 @@
 
 #include "Tester.h"
 
+#include <chrono>
+#include <iostream>
+#include <set>
+
+#ifndef _MSC_VER
+#  include <sys/stat.h>
+#  include <utime.h>
+#endif
+
+#include "build/Generators.h"
+#include "build/LanguageInfo.h"
+#include "build/Snapshot.h"
+#include "build/Target.h"
+
 #include "script/Interpreter.h"
+#include "script/MemoryProfiler.h"
+#include "script/Profiler.h"
+#include "script/Stack.h"
 
 #include "util/FSUtil.h"
 #include "util/StringUtil.h"
@@ -13,8 +30,440 @@
 using std::vector;
 using std::string;
 
+// Times a loop calling a function of a few statements, on the plain
+// interpreter, with a no-op debugger hook attached (which forces the
+// instrumented statement loop) and with the profiler attached, and how much
+// slower the latter two are. (Loop bodies are not run by the statement loop,
+// function bodies are, so the time is mostly spent in it.)
+static int benchmark()
+{
+	const string dir = FSUtil::mkdtemp("scripttest");
+	FSUtil::setContents(FSUtil::combinePaths({dir, "Phoenixfile.phnx"}),
+		"$step = function() {\n"
+		"	$a = $__arguments.i % 7;\n"
+		"	$b = $a * 2;\n"
+		"	$c = $b + 1;\n"
+		"	return $c;\n"
+		"};\n"
+		"$i = 0;\n"
+		"$sum = 0;\n"
+		"while ($i < 50000) {\n"
+		"	$sum += $step(i: $i);\n"
+		"	$i++;\n"
+		"}\n"
+		"return $sum;\n");
+
+	// The modes take turns, so that the machine getting faster or slower
+	// along the way doesn't favor one of them.
+	const char* modes[] = {"plain", "hooked", "profiled"};
+	double best[3] = {0, 0, 0};
+	for (int run = 0; run < 7; run++) {
+		for (int mode = 0; mode < 3; mode++) {
+			Script::Stack stack;
+			if (mode == 1)
+				stack.mInterpreterHook = [](const string&, const Script::SourceView&, const uint32_t) {};
+			else if (mode == 2)
+				stack.mProfiler = new Script::Profiler;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Script::Run(&stack, dir);
+			const double ms = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count();
+			delete stack.mProfiler;
+			if (run == 0 || ms < best[mode])
+				best[mode] = ms;
+		}
+	}
+	for (int mode = 0; mode < 3; mode++) {
+		std::cout << modes[mode] << ": " << best[mode] << " ms";
+		if (mode != 0)
+			std::cout << " (" << (int)((best[mode] / best[0] - 1) * 100) << "% over plain)";
+		std::cout << std::endl;
+	}
+	FSUtil::rmdir(dir, true);
+	return 0;
+}
+
+// The stacks configure() evaluated on, which the languages may still use.
+static vector<Script::Stack*> sStacks;
+// The subdirectories whose scripts called `evaluated`, which (unlike writing
+// a file) a restored snapshot does not do again.
+static std::set<string> sEvaluated;
+
+static Script::Stack* createStack()
+{
+	Script::Stack* stack = new Script::Stack();
+	Target::addGlobalFunction(stack);
+	stack->GlobalFunctions.insert({"evaluated", Script::Function([](Script::Stack*,
+			Script::Object, Script::ObjectMap& params) -> Script::Object {
+		sEvaluated.insert(params.get("0")->asStringRaw());
+		return Script::UndefinedObject();
+	})});
+	stack->addSuperglobal("Compilers", Script::MapObject(new Script::ObjectMap()), true);
+	return stack;
+}
+
+/*! Configures `dir` as Phoenix does (minus writing build files), from the
+ * snapshot in `file` if `reuse` and it can be, saving it again afterwards.
+ * `result` gets what was reused: `Changed` if only some regions were
+ * re-evaluated, and `Stale` if the scripts were run in full. */
+static bool configure(const string& dir, const string& file, bool reuse,
+	Snapshot::Result& result)
+{
+	Snapshot::reset();
+	vector<string> inputFiles;
+	string projectName;
+	result = reuse ? Snapshot::load(file, "scripttest", inputFiles, projectName) : Snapshot::Stale;
+	try {
+		if (result == Snapshot::Changed && !Snapshot::reevaluate(createStack, inputFiles))
+			result = Snapshot::Stale;
+		if (result == Snapshot::Unchanged)
+			Snapshot::replay();
+		if (result == Snapshot::Stale) {
+			Script::Stack* stack = createStack();
+			sStacks.push_back(stack);
+			LanguageInfo::sStack = stack;
+			Snapshot::startRecording();
+			LanguageInfo::addSuperglobals(stack);
+			Script::Run(stack, dir);
+			LanguageInfo::waitForChecks();
+			inputFiles = stack->inputFiles();
+		}
+	} catch (Script::Exception e) {
+		e.print();
+		return false;
+	}
+	return result == Snapshot::Unchanged || Snapshot::save(file, "scripttest", inputFiles);
+}
+
+// The build model, to compare one way of computing it with another.
+static string describeTargets()
+{
+	string ret;
+	for (const Target* target : Target::targets) {
+		ret += target->name + " (" + StringUtil::join(target->languages, ", ") + ") " +
+			target->standardsModeFlag + " " + target->definitionsFlags + " " + target->otherFlags;
+		for (const Path& path : target->includeDirs)
+			ret += " -I" + path.str();
+		for (const Path& path : target->sourceFiles)
+			ret += " " + path.str();
+		for (const Path& path : target->extraFiles)
+			ret += " +" + path.str();
+		ret += "\n";
+	}
+	return ret;
+}
+
+// Saving and restoring the build model (see Snapshot), on a small tree of
+// subdirectories, one of which reads a file. Each subdirectory's script
+// calls `evaluated`, which shows whether it was run again.
+static void testSnapshots(Tester& t)
+{
+	t.beginGroup("Snapshot");
+	const string dir = FSUtil::mkdtemp("scripttest");
+	LanguageInfo::sProbeDirectory = FSUtil::mkdtemp("scripttest");
+	const string file = FSUtil::combinePaths({dir, "phoenix.snapshot"});
+	auto write = [&](const string& name, const string& contents) {
+		FSUtil::setContents(FSUtil::combinePaths({dir, name}), contents);
+	};
+	auto evaluated = [&](const string& subdirectory) {
+		return sEvaluated.count(subdirectory) != 0;
+	};
+	auto forgetEvaluated = [&]() {
+		sEvaluated.clear();
+	};
+	FSUtil::mkdir(FSUtil::combinePaths({dir, "a"}));
+	FSUtil::mkdir(FSUtil::combinePaths({dir, "b"}));
+	FSUtil::mkdir(FSUtil::combinePaths({dir, "b", "leaf"}));
+	write("Phoenixfile.phnx",
+		"$flag = \"ROOT\";\n"
+		"subdirectory \"a\";\n"
+		"subdirectory \"b\";\n"
+		"$root = CreateTarget(\"root\", language: \"C\");\n"
+		"$root.addSources([\"root.c\"]);\n");
+	write("a/Phoenixfile.phnx",
+		"evaluated(\"a\");\n"
+		"$generated = File(\"generated.h\");\n"
+		"$generated.setContents(\"#define A 1\\n\");\n"
+		"$a = CreateTarget(\"liba\", language: \"C\");\n"
+		"$a.addSources([\"a.c\"]);\n"
+		"$version = File(\"version.txt\");\n"
+		"$a.addDefinitions([$flag, \"VERSION=\" + $version.getContents()]);\n");
+	write("a/version.txt", "1");
+	write("b/Phoenixfile.phnx",
+		"evaluated(\"b\");\n"
+		"$b = CreateTarget(\"libb\", language: \"C++\");\n"
+		"$b.addSources([\"b.cpp\"]);\n"
+		"subdirectory \"leaf\";\n");
+	const string leaf =
+		"evaluated(\"b/leaf\");\n"
+		"$leaf = CreateTarget(\"libleaf\", language: \"C\");\n"
+		"$leaf.addSources([\"leaf.c\"]);\n";
+	write("b/leaf/Phoenixfile.phnx", leaf + "$leaf.addDefinitions([\"LEAF=1\"]);\n");
+
+	Snapshot::Result result;
+	bool ok = configure(dir, file, false, result);
+	const string fresh = describeTargets();
+	t.result(ok && FSUtil::isFile(file) && fresh.find("VERSION=1") != string::npos,
+		"snapshot-1#saved");
+	ok = configure(dir, file, true, result);
+	t.result(ok && result == Snapshot::Unchanged && describeTargets() == fresh,
+		"snapshot-2#restored");
+
+	// Anything the model was computed from changing must invalidate it.
+	const string saved = FSUtil::getContents(file);
+	Snapshot::reset();
+	vector<string> inputFiles;
+	string projectName;
+	t.result(Snapshot::load(file, "scripttest --other", inputFiles, projectName) ==
+		Snapshot::Stale, "snapshot-3#command-line");
+	FSUtil::setContents(file, saved.substr(0, saved.length() / 2));
+	t.result(Snapshot::load(file, "scripttest", inputFiles, projectName) == Snapshot::Stale &&
+		Target::targets.empty(), "snapshot-4#truncated");
+	FSUtil::setContents(file, saved);
+
+	write("a/version.txt", "2");
+	ok = configure(dir, file, true, result);
+	const string changed = describeTargets();
+	configure(dir, file, false, result);
+	t.result(ok && changed.find("VERSION=2") != string::npos && changed == describeTargets(),
+		"snapshot-5#read-file");
+
+	// Only the subdirectory whose script changed is evaluated again, and what
+	// it produces takes the place of what it did before.
+	forgetEvaluated();
+	write("b/leaf/Phoenixfile.phnx", leaf + "$leaf.addDefinitions([\"LEAF=2\"]);\n");
+	ok = configure(dir, file, true, result);
+	const Snapshot::Result leafResult = result;
+	const bool onlyLeaf = !evaluated("a") && !evaluated("b") && evaluated("b/leaf");
+	const string spliced = describeTargets();
+	configure(dir, file, false, result);
+	t.result(ok && leafResult == Snapshot::Changed && onlyLeaf &&
+		spliced.find("LEAF=2") != string::npos && spliced == describeTargets(),
+		"snapshot-6#region");
+
+	// $$Compilers is changed by the parent (libb is the first C++ target), so
+	// a subdirectory that reads it cannot be evaluated on its own.
+	write("b/leaf/Phoenixfile.phnx", leaf + "$compiler = \"\" + $$Compilers[\"C++\"];\n"
+		"$leaf.addDefinitions([\"LEAF=3\"]);\n");
+	configure(dir, file, false, result);
+	forgetEvaluated();
+	write("b/leaf/Phoenixfile.phnx", leaf + "$compiler = \"\" + $$Compilers[\"C++\"];\n"
+		"$leaf.addDefinitions([\"LEAF=4\"]);\n");
+	ok = configure(dir, file, true, result);
+	const Snapshot::Result superglobalResult = result;
+	const bool all = evaluated("a") && evaluated("b") && evaluated("b/leaf");
+	const string rerun = describeTargets();
+	configure(dir, file, false, result);
+	t.result(ok && superglobalResult == Snapshot::Stale && all &&
+		rerun.find("LEAF=4") != string::npos && rerun == describeTargets(),
+		"snapshot-7#superglobal");
+
+	// What the scripts wrote is written again, whether the snapshot is
+	// restored as it was or only some regions are evaluated again.
+	write("b/leaf/Phoenixfile.phnx", leaf);
+	configure(dir, file, false, result);
+	const string generated = FSUtil::combinePaths({dir, "a", "generated.h"});
+	FSUtil::deleteFile(generated);
+	forgetEvaluated();
+	ok = configure(dir, file, true, result);
+	t.result(ok && result == Snapshot::Unchanged && !evaluated("a") &&
+		FSUtil::getContents(generated) == "#define A 1\n", "snapshot-8#written-file");
+	FSUtil::deleteFile(generated);
+	write("b/Phoenixfile.phnx", "evaluated(\"b\");\n"
+		"$b = CreateTarget(\"libb\", language: \"C++\");\n"
+		"$b.addSources([\"b.cpp\", \"b2.cpp\"]);\n"
+		"subdirectory \"leaf\";\n");
+	ok = configure(dir, file, true, result);
+	t.result(ok && result == Snapshot::Changed && !evaluated("a") && evaluated("b") &&
+		FSUtil::getContents(generated) == "#define A 1\n", "snapshot-9#written-file-region");
+
+	Snapshot::reset();
+	FSUtil::rmdir(dir, true);
+	t.endGroup();
+}
+
+// The number of calls the profile report `report` lists for `key`.
+static long long profiledCalls(const string& report, const string& key)
+{
+	for (StringUtil::SplitIterator line(report, "\n"); line.next(); ) {
+		const string str = line.str();
+		if (!StringUtil::endsWith(str, "  " + key))
+			continue;
+		const vector<string> fields = StringUtil::split(StringUtil::trim(str), " ");
+		vector<string> values;
+		for (const string& field : fields) {
+			if (!field.empty())
+				values.push_back(field);
+		}
+		return values.size() >= 4 ? std::atoll(values[2].c_str()) : -1;
+	}
+	return -1;
+}
+
+// Profiling a script with a function called from a loop.
+static void testProfiler(Tester& t)
+{
+	t.beginGroup("Profiler");
+	const string dir = FSUtil::mkdtemp("scripttest");
+	const string file = FSUtil::combinePaths({dir, "Phoenixfile.phnx"});
+	FSUtil::setContents(file,
+		"$f = function() {\n"
+		"	return 1;\n"
+		"};\n"
+		"$i = 0;\n"
+		"while ($i < 3) {\n"
+		"	$f();\n"
+		"	$i++;\n"
+		"}\n"
+		"$g = $f;\n"
+		"$g();\n");
+	const string prefix = FSUtil::combinePaths({dir, "profile"});
+	{
+		Script::Stack stack;
+		stack.mProfiler = new Script::Profiler;
+		try {
+			Script::Run(&stack, dir);
+		} catch (Script::Exception e) {
+			e.print();
+		}
+		t.result(stack.mProfiler->write(prefix), "profile-1#written");
+		delete stack.mProfiler;
+	}
+
+	// Statements are counted where the interpreter runs them one by one: at
+	// the top level of a file or function (a loop counts as one.)
+	const string report = FSUtil::getContents(prefix + ".txt");
+	t.result(profiledCalls(report, file + ":1") == 1 && profiledCalls(report, file + ":2") == 4 &&
+		profiledCalls(report, file + ":4") == 1 && profiledCalls(report, file + ":5") == 1,
+		"profile-2#statements");
+	// Calls are counted by function, whichever name it is called by.
+	const string function = "$f (" + file + ":1)";
+	t.result(profiledCalls(report, function) == 4 && report.find("$g") == string::npos,
+		"profile-3#calls");
+
+	// Folded stacks: frames separated by ';', then a space and a number.
+	const string folded = FSUtil::getContents(prefix + ".folded");
+	bool parsed = !folded.empty(), nested = false;
+	for (StringUtil::SplitIterator line(folded, "\n"); line.next(); ) {
+		if (line.empty())
+			continue;
+		const string str = line.str();
+		const string::size_type space = str.rfind(' ');
+		parsed = parsed && space != string::npos && space > 0 && space + 1 < str.length() &&
+			str.find_first_not_of("0123456789", space + 1) == string::npos;
+		nested = nested || str.substr(0, space) == file + ":5;" + function + ";" + file + ":2";
+	}
+	t.result(parsed && nested, "profile-4#folded");
+
+	FSUtil::rmdir(dir, true);
+	t.endGroup();
+}
+
+// Profiling the memory of a script that allocates lists and a map.
+static void testMemoryProfiler(Tester& t)
+{
+	t.beginGroup("MemoryProfiler");
+	const string dir = FSUtil::mkdtemp("scripttest");
+	const string file = FSUtil::combinePaths({dir, "Phoenixfile.phnx"});
+	FSUtil::setContents(file,
+		"$list = [1, 2, 3];\n"
+		"$map = Map(a: 1, b: 2);\n"
+		"$last = [4];\n"
+		"$last = [5, 6];\n");
+	const string output = FSUtil::combinePaths({dir, "memory.txt"});
+	{
+		Script::MemoryProfiler profiler;
+		Script::Stack stack;
+		try {
+			Script::Run(&stack, dir);
+		} catch (Script::Exception e) {
+			e.print();
+		}
+		t.result(profiler.write(output, &stack), "memory-1#written");
+	}
+
+	// The live and total counts of what `kind` the report lists for `line`.
+	const string report = FSUtil::getContents(output);
+	auto counts = [&](const string& kind, int line) {
+		const string location = file + ":" + std::to_string(line);
+		for (StringUtil::SplitIterator it(report, "\n"); it.next(); ) {
+			vector<string> values;
+			for (const string& field : StringUtil::split(it.str(), " ")) {
+				if (!field.empty())
+					values.push_back(field);
+			}
+			if (values.size() == 6 && values[4] == kind && values[5] == location)
+				return values[1] + "/" + values[3];
+		}
+		return string();
+	};
+	// Lists are counted once for the literal and once for the copy assigned.
+	t.result(counts("list", 1) == "1/2", "memory-2#list");
+	// (Map() also makes one for its arguments, which is not kept.)
+	t.result(StringUtil::startsWith(counts("map", 2), "1/"), "memory-3#map");
+	t.result(counts("list", 3) == "0/2" && counts("list", 4) == "1/2", "memory-4#freed");
+	t.result(report.find("3  $list (" + file + ":1)") != string::npos &&
+		report.find("2  $map (" + file + ":2)") != string::npos, "memory-5#reachable");
+	FSUtil::rmdir(dir, true);
+	t.endGroup();
+}
+
+#ifndef _MSC_VER
+// The file of source globs (see Generators::writeGlobs) is touched, which
+// makes Ninja rerun Phoenix, exactly when what they match changed.
+static void testGlobs(Tester& t)
+{
+	t.beginGroup("Globs");
+	const string dir = FSUtil::mkdtemp("scripttest");
+	const string file = FSUtil::combinePaths({dir, "phoenix.globs"});
+	const string sources = FSUtil::combinePaths({dir, "src"});
+	FSUtil::mkdir(sources);
+	FSUtil::setContents(FSUtil::combinePaths({sources, "main.c"}), "");
+	struct ::utimbuf old = {1000000000, 1000000000};
+	auto record = [&]() {
+		Generator::Glob glob;
+		glob.directory = sources;
+		glob.extensions = {".c"};
+		glob.recursive = true;
+		glob.results = FSUtil::searchForFiles(sources, glob.extensions, true,
+			&glob.directories);
+		const bool ret = Generators::writeGlobs(file, {glob});
+		::utime(file.c_str(), &old);
+		return ret;
+	};
+	auto touched = [&]() {
+		struct ::stat statbuf;
+		return Generators::checkGlobs(file) && ::stat(file.c_str(), &statbuf) == 0 &&
+			statbuf.st_mtime != old.modtime;
+	};
+
+	t.result(record() && !touched(), "globs-1#unchanged");
+	FSUtil::setContents(FSUtil::combinePaths({sources, ".main.c.swp"}), "");
+	FSUtil::setContents(FSUtil::combinePaths({sources, "main.c~"}), "");
+	t.result(!touched(), "globs-2#irrelevant");
+	FSUtil::setContents(FSUtil::combinePaths({sources, "added.c"}), "");
+	t.result(touched(), "globs-3#added");
+	record();
+	FSUtil::deleteFile(FSUtil::combinePaths({sources, "added.c"}));
+	t.result(touched(), "globs-4#removed");
+	record();
+	FSUtil::mkdir(FSUtil::combinePaths({sources, "sub"}));
+	t.result(touched(), "globs-5#subdirectory");
+	record();
+	FSUtil::setContents(file, "not a glob\n");
+	::utime(file.c_str(), &old);
+	t.result(touched() && FSUtil::getContents(file) == "not a glob\n", "globs-6#malformed");
+
+	FSUtil::rmdir(dir, true);
+	t.endGroup();
+}
+#endif
+
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && string(argv[1]) == "--benchmark")
+		return benchmark();
+
 	vector<string> files = FSUtil::searchForFiles(FSUtil::combinePaths({__FILE__,
 		"..", "script-tests"}), {".phnx"}, false);
 	Tester t(true);
@@ -35,19 +484,60 @@ int main(int argc, char* argv[])
 		}
 		string expect = test.substr(openerLen + addToLen, test.find_first_of("\n") - (openerLen + addToLen));
 
+		// Subdirectory tests also run with parallel evaluation enabled.
+		const unsigned int maxJobs = StringUtil::startsWith(name, "subdir-") ? 4 : 1;
+		for (unsigned int jobs = 1; jobs <= maxJobs; jobs += 3) {
+			Script::Stack stack;
+			stack.mParallelJobs = jobs;
+			string result;
+			try {
+				result = Script::Run(&stack, i)->asStringPretty();
+			} catch (Script::Exception e) {
+				if (expect[0] != 'E')
+					e.print();
+				result = "E";
+				result += e.what();
+			}
+
+			bool res = (result == expect);
+			t.result(res, name + (jobs > 1 ? " (parallel)" : "") +
+				(res ? "" : " (got " + result + ", expected " + expect + ")"));
+		}
+	}
+
+	// Functions refer into the script they were defined in, and have to keep
+	// working after it is truncated (as an editor saving it under `--watch`
+	// does), however big it was.
+	{
+		const string dir = FSUtil::mkdtemp("scripttest");
+		const string file = FSUtil::combinePaths({dir, "Phoenixfile.phnx"});
+		string code = "$f = function() { return \"kept\"; };\n";
+		while (code.length() < 64 * 1024)
+			code += "# padding, so that the function's body is not near the end\n";
+		FSUtil::setContents(file, code + "return $f;\n");
 		Script::Stack stack;
 		string result;
 		try {
-			result = Script::Run(&stack, i)->asStringPretty();
+			Script::Object function = Script::Run(&stack, dir);
+			FSUtil::setContents(file, "");
+			Script::ObjectMap args;
+			result = function->function->call(&stack, nullptr, args)->asStringRaw();
 		} catch (Script::Exception e) {
-			if (expect[0] != 'E')
-				e.print();
-			result = "E";
-			result += e.what();
+			e.print();
 		}
-
-		bool res = (result == expect);
-		t.result(res, name + (res ? "" : " (got " + result + ", expected " + expect + ")"));
+		FSUtil::rmdir(dir, true);
+		t.result(result == "kept", "source-truncated-1");
 	}
+
+	testSnapshots(t);
+	testProfiler(t);
+	testMemoryProfiler(t);
+#ifndef _MSC_VER
+	testGlobs(t);
+#endif
+	LanguageInfo::finishPending();
+	FSUtil::rmdir(LanguageInfo::sProbeDirectory, true);
+	for (Script::Stack* stack : sStacks)
+		delete stack;
 	return t.done();
 }
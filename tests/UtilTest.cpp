@@ -4,16 +4,348 @@
  */
 
 #include <cstdlib>
+#include <climits>
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#ifndef _MSC_VER
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <utime.h>
+#else
+#  include <direct.h>
+#  define getcwd _getcwd
+#  define PATH_MAX 260
+#endif
 
 #include "Tester.h"
 
 #include "util/StringUtil.h"
 #include "util/FSUtil.h"
+#include "util/OSUtil.h"
+#include "util/Path.h"
+#include "util/TraceUtil.h"
 #include "util/XmlUtil.h"
 
-int main(int, char* argv[])
+// Compares the memory 200,000 source paths (all with different names, in
+// 2,000 directories) take as strings and as Paths, and the time to intern them.
+static void benchmarkPaths()
 {
+	std::vector<std::string> strings;
+	for (int i = 0; i < 200000; i++) {
+		strings.push_back("/home/user/projects/example/src/module" +
+			std::to_string(i / 1000) + "/part" + std::to_string(i / 100 % 10) +
+			"/source_file_" + std::to_string(i) + ".cpp");
+	}
+	size_t stringBytes = strings.capacity() * sizeof(std::string);
+	for (const std::string& string : strings)
+		stringBytes += string.capacity() + 1;
+
+	size_t paths, components, before, after;
+	Path::statistics(paths, components, before);
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<Path> interned;
+	interned.reserve(strings.size());
+	for (const std::string& string : strings)
+		interned.push_back(Path(string));
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	Path::statistics(paths, components, after);
+	const size_t pathBytes = interned.capacity() * sizeof(Path) + after - before;
+
+	std::cout << "200000 paths as strings: " << stringBytes / 1024 << " KiB" << std::endl;
+	std::cout << "200000 paths as Paths: " << pathBytes / 1024 << " KiB (interned in " <<
+		std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+}
+
+// Times recursive searches of a synthetic tree of 100,000 files (in 1,111
+// directories) with different numbers of threads. The listings are cleared
+// before each search, but the OS's own caches will be warm.
+static void benchmarkSearch()
+{
+	const std::string root = FSUtil::mkdtemp("utilbench");
+	for (int i = 0; i < 10; i++) {
+		const std::string first = FSUtil::combinePaths({root, std::to_string(i)});
+		FSUtil::mkdir(first);
+		for (int j = 0; j < 10; j++) {
+			const std::string second = FSUtil::combinePaths({first, std::to_string(j)});
+			FSUtil::mkdir(second);
+			for (int k = 0; k < 10; k++) {
+				const std::string leaf = FSUtil::combinePaths({second, std::to_string(k)});
+				FSUtil::mkdir(leaf);
+				for (int f = 0; f < 100; f++)
+					FSUtil::setContents(FSUtil::combinePaths({leaf, std::to_string(f) + ".c"}), "");
+			}
+		}
+	}
+
+	std::vector<std::string> expected;
+	for (unsigned int jobs : {1, 2, 4, 8, 16}) {
+		FSUtil::sSearchJobs = jobs;
+		double best = 0;
+		for (int run = 0; run < 5; run++) {
+			FSUtil::clearDirectoryCache();
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const std::vector<std::string> files = FSUtil::searchForFiles(root, {".c"}, true);
+			const double ms = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count();
+			if (run == 0 || ms < best)
+				best = ms;
+			if (expected.empty())
+				expected = files;
+			else if (files != expected)
+				std::cout << "results differ with " << jobs << " threads!" << std::endl;
+		}
+		std::cout << jobs << " thread(s): " << best << " ms (" << expected.size() <<
+			" files)" << std::endl;
+	}
+	FSUtil::rmdir(root, true);
+}
+
+// The per-file cost of making relative paths (like searchForFiles returns)
+// absolute: looking up the working directory for each, as absolutePath() used
+// to; with it cached; in a batch; and as Paths.
+static void benchmarkAbsolute()
+{
+	std::vector<std::string> relative;
+	for (int i = 0; i < 100000; i++)
+		relative.push_back("src/module" + std::to_string(i / 100) + "/file" + std::to_string(i) + ".cpp");
+
+	const char* modes[] = {"getcwd each time", "absolutePath", "absolutePaths", "Path::absolute"};
+	for (int mode = 0; mode < 4; mode++) {
+		std::vector<std::string> paths = relative;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (mode == 0) {
+			for (std::string& path : paths) {
+				char cwd[PATH_MAX];
+				if (getcwd(cwd, sizeof(cwd)) != NULL)
+					path = FSUtil::combinePaths({cwd, path});
+			}
+		} else if (mode == 1) {
+			for (std::string& path : paths)
+				path = FSUtil::absolutePath(path);
+		} else if (mode == 2) {
+			FSUtil::absolutePaths(paths);
+		} else {
+			for (std::string& path : paths)
+				Path(path).absolute();
+		}
+		const double ns = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / paths.size();
+		std::cout << modes[mode] << ": " << ns << " ns per file" << std::endl;
+	}
+}
+
+// Splits, joins and escapes 20,000 paths (one string of about 700 KB),
+// comparing the old ways of doing so with StringUtil's.
+static void benchmarkStrings()
+{
+	std::string text;
+	for (int i = 0; i < 20000; i++)
+		text += "C:/src/module " + std::to_string(i / 100) + "/file<" + std::to_string(i) + ">.cpp\n";
+
+	auto time = [](const char* what, const std::function<size_t()>& function) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const size_t result = function();
+		std::cout << what << ": " << std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count() << " ms (" << result << ")" << std::endl;
+	};
+	std::vector<std::string> lines;
+	time("split", [&]() { lines = StringUtil::split(text, "\n"); return lines.size(); });
+	time("SplitIterator", [&]() {
+		size_t length = 0;
+		for (StringUtil::SplitIterator it(text, "\n"); it.next(); )
+			length += it.length();
+		return length;
+	});
+	time("join, appending", [&]() {
+		std::string ret;
+		for (const std::string& line : lines)
+			ret += line + "\n";
+		return ret.length();
+	});
+	time("join", [&]() { return StringUtil::join(lines, "\n").length(); });
+	time("replace in place", [&]() {
+		std::string ret = text;
+		for (size_t pos = 0; (pos = ret.find(" ", pos)) != std::string::npos; pos += 2)
+			ret.replace(pos, 1, "$ ");
+		return ret.length();
+	});
+	time("replaceAll", [&]() {
+		std::string ret = text;
+		StringUtil::replaceAll(ret, " ", "$ ");
+		return ret.length();
+	});
+	time("replaceAll x3", [&]() {
+		std::string ret = text;
+		StringUtil::replaceAll(ret, "$", "$$");
+		StringUtil::replaceAll(ret, ":", "$:");
+		StringUtil::replaceAll(ret, " ", "$ ");
+		return ret.length();
+	});
+	time("replaceEach", [&]() {
+		return StringUtil::replaceEach(text, {{"$", "$$"}, {":", "$:"}, {" ", "$ "}}).length();
+	});
+	const StringUtil::Escaper escaper({{'$', "$$"}, {':', "$:"}, {' ', "$ "}, {'\n', "$\n"}});
+	time("escaping for Ninja, replaceAll x2", [&]() {
+		size_t length = 0;
+		for (const std::string& line : lines) {
+			std::string ret = line;
+			StringUtil::replaceAll(ret, ":", "$:");
+			StringUtil::replaceAll(ret, " ", "$ ");
+			length += ret.length();
+		}
+		return length;
+	});
+	time("escaping for Ninja, Escaper", [&]() {
+		std::string ret;
+		for (const std::string& line : lines)
+			escaper.append(ret, line);
+		return ret.length();
+	});
+	time("Escaper", [&]() { return escaper(text).length(); });
+	time("XmlGenerator::escape", [&]() { return XmlGenerator::escape(text).length(); });
+}
+
+// Writes a Ninja-like manifest for 200,000 sources (about 20 MB) by joining
+// all of its lines into one string, as NinjaGenerator used to, and through an
+// AtomicWriter, as it does now.
+static void benchmarkWriter()
+{
+	const std::string dir = FSUtil::mkdtemp("utilbench");
+	const std::string file = FSUtil::combinePaths({dir, "build.ninja"});
+	auto edge = [](int i) {
+		return "build build-big/file_" + std::to_string(i) + ".c.o: langC /home/user/big/src/m" +
+			std::to_string(i / 1000) + "/file_" + std::to_string(i) + ".c\n  targetflags = $tf_big";
+	};
+	for (int mode = 0; mode < 2; mode++) {
+		// (So the writer doesn't just find the file is the same.)
+		FSUtil::deleteFile(file);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t held = 0;
+		if (mode == 0) {
+			std::vector<std::string> lines;
+			for (int i = 0; i < 200000; i++)
+				lines.push_back(edge(i));
+			const std::string contents = StringUtil::join(lines, "\n") + "\n";
+			for (const std::string& line : lines)
+				held += line.capacity();
+			held += contents.capacity();
+			FSUtil::setContents(file, contents);
+		} else {
+			FSUtil::AtomicWriter writer(file);
+			for (int i = 0; i < 200000; i++)
+				writer << edge(i) + "\n";
+			writer.commit();
+			held = 1 << 20;
+		}
+		std::cout << (mode == 0 ? "join and setContents: " : "AtomicWriter: ") <<
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() <<
+			" ms, " << held / 1024 << " KiB held at once" << std::endl;
+	}
+	FSUtil::rmdir(dir, true);
+}
+
+// Lays out 500 targets of 20 sources each as NinjaGenerator used to (all in
+// build.ninja) and does now (a subninja per target, with the rules in
+// rules.ninja); times regenerating both after one target changed, and, if
+// Ninja is installed, how long `ninja -n` takes to start with each.
+static void benchmarkSubninja()
+{
+	const std::string root = FSUtil::mkdtemp("utilbench");
+	const std::string rules = "rule cc\n  command = cc -c $in -o $out $targetflags\n\n"
+		"rule link\n  command = cc $in -o $out\n\n";
+	auto target = [](int t, const std::string& flags) {
+		std::string ret = "tf_t" + std::to_string(t) + " = " + flags + "\n", objects;
+		for (int s = 0; s < 20; s++) {
+			const std::string object = "build-t" + std::to_string(t) + "/s" + std::to_string(s) + ".c.o";
+			ret += "build " + object + ": cc /home/user/project/t" + std::to_string(t) + "/s" +
+				std::to_string(s) + ".c\n  targetflags = $tf_t" + std::to_string(t) + "\n";
+			objects += " " + object;
+		}
+		return ret + "build t" + std::to_string(t) + ": link" + objects + "\n";
+	};
+	auto generate = [&](const std::string& dir, bool split, int changed) {
+		FSUtil::AtomicWriter manifest(FSUtil::combinePaths({dir, "build.ninja"}));
+		std::vector<FSUtil::AtomicWriter*> targets;
+		if (split) {
+			FSUtil::AtomicWriter rulesManifest(FSUtil::combinePaths({dir, "rules.ninja"}));
+			rulesManifest << rules;
+			rulesManifest.commit();
+			manifest << "include rules.ninja\n";
+		} else {
+			manifest << rules;
+		}
+		for (int t = 0; t < 500; t++) {
+			const std::string contents = target(t, t == changed ? "-O2" : "-O1") + "\n";
+			if (!split) {
+				manifest << contents;
+				continue;
+			}
+			const std::string name = "build-t" + std::to_string(t) + ".ninja";
+			targets.push_back(new FSUtil::AtomicWriter(FSUtil::combinePaths({dir, name})));
+			*targets.back() << contents;
+			targets.back()->finish();
+			manifest << "subninja " + name + "\n";
+		}
+		manifest << "default";
+		for (int t = 0; t < 500; t++)
+			manifest << " t" + std::to_string(t);
+		manifest << "\n";
+		for (FSUtil::AtomicWriter* writer : targets) {
+			writer->commit();
+			delete writer;
+		}
+		manifest.commit();
+	};
+
+	const std::string ninja = FSUtil::which("ninja");
+	for (bool split : {false, true}) {
+		const std::string dir = FSUtil::combinePaths({root, split ? "split" : "single"});
+		FSUtil::mkdir(dir);
+		generate(dir, split, -1);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		generate(dir, split, 250);
+		std::cout << (split ? "subninja per target: " : "one build.ninja: ") << "regenerated in " <<
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() <<
+			" ms";
+		if (!ninja.empty()) {
+			double best = 0;
+			for (int run = 0; run < 5; run++) {
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				OSUtil::exec(ninja, "-n -C " + dir);
+				const double ms = std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - start).count();
+				if (run == 0 || ms < best)
+					best = ms;
+			}
+			std::cout << ", `ninja -n` in " << best << " ms";
+		}
+		std::cout << std::endl;
+	}
+	if (ninja.empty())
+		std::cout << "(Ninja isn't installed, so `ninja -n` wasn't timed.)" << std::endl;
+	FSUtil::rmdir(root, true);
+}
+
+static int benchmark()
+{
+	benchmarkSubninja();
+	benchmarkWriter();
+	benchmarkStrings();
+	benchmarkAbsolute();
+	benchmarkPaths();
+	benchmarkSearch();
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+		return benchmark();
+
 	Tester t(true);
 
 	t.beginGroup("StringUtil");
@@ -58,6 +390,70 @@ int main(int, char* argv[])
 	replace = "stRing subject StRING tO replace-INSIDE";
 	StringUtil::replaceAll(replace, "RING", "ring");
 	t.result(replace ==	"stRing subject String tO replace-INSIDE", "replaceAll-2");
+
+	const std::string toSplit = ":a::bc:", fieldsToSplit = "a\tbc";
+	std::string splitAgain;
+	for (StringUtil::SplitIterator it(toSplit, ":"); it.next(); )
+		splitAgain += "[" + it.str() + "]";
+	t.result(splitAgain == "[][a][][bc][]" &&
+		StringUtil::split(toSplit, ":").size() == 5, "SplitIterator-1");
+	StringUtil::SplitIterator fields(fieldsToSplit, "\t");
+	t.result(fields.next() && fields == "a" && fields.next() && fields == "bc" &&
+		fields.position() == 2 && !fields.next(), "SplitIterator-2");
+
+	t.result(StringUtil::replaceEach("a <b> & \"c\"", {{"&", "&amp;"}, {"<", "&lt;"},
+		{">", "&gt;"}, {"\"", "&quot;"}}) == "a &lt;b&gt; &amp; &quot;c&quot;", "replaceEach-1");
+	// Replacements aren't replaced again, and earlier patterns take precedence.
+	t.result(StringUtil::replaceEach("x:y z::", {{"::", "#"}, {":", "$:"}, {"$", "$$"}}) ==
+		"x$:y z#", "replaceEach-2");
+
+	{
+		// Random strings, heavy on the characters that get escaped, against
+		// escaping one character at a time.
+		typedef std::vector<std::pair<char, std::string> > Escapes;
+		const Escapes ninja = {{'$', "$$"}, {':', "$:"}, {' ', "$ "}, {'\n', "$\n"}},
+			xml = {{'&', "&amp;"}, {'<', "&lt;"}, {'>', "&gt;"}, {'"', "&quot;"},
+				{'\'', "&apos;"}, {'\t', "&#9;"}, {'\n', "&#10;"}, {'\r', "&#13;"}},
+			many = {{'a', "A"}, {'b', "B"}, {'c', "C"}, {'d', "D"}, {'e', "E"},
+				{'f', "F"}, {'g', "G"}, {'h', "H"}, {'$', ""}};
+		auto reference = [](const Escapes& escapes, const std::string& str) {
+			std::string ret;
+			for (char c : str) {
+				Escapes::const_iterator it = std::find_if(escapes.begin(), escapes.end(),
+					[c](const std::pair<char, std::string>& escape) { return escape.first == c; });
+				if (it != escapes.end())
+					ret += it->second;
+				else
+					ret += c;
+			}
+			return ret;
+		};
+		const StringUtil::Escaper ninjaEscaper(ninja), manyEscaper(many);
+		const std::string alphabet = "abcdefgh$: \n&<>\"'\t\r";
+		std::mt19937 random(1);
+		bool same = true;
+		for (int i = 0; i < 5000 && same; i++) {
+			std::string str(random() % 70, '\0');
+			// Every other string is mostly plain, so there are runs to skip.
+			for (char& c : str) {
+				if (i % 2 == 1 && random() % 16 != 0)
+					c = 'x';
+				else
+					c = (random() % 4 == 0) ? (char)(random() % 256) : alphabet[random() % alphabet.length()];
+			}
+			std::string appended = "prefix";
+			ninjaEscaper.append(appended, str);
+			same = ninjaEscaper(str) == reference(ninja, str) &&
+				appended == "prefix" + reference(ninja, str) &&
+				XmlGenerator::escape(str) == reference(xml, str) &&
+				manyEscaper(str) == reference(many, str);
+		}
+		t.result(same, "Escaper-1#random");
+	}
+
+	t.result(StringUtil::hash("") == 0xcbf29ce484222325ULL, "hash-1");
+	t.result(StringUtil::hash("a") == 0xaf63dc4c8601ec8cULL, "hash-2");
+	t.result(StringUtil::hash("foobar") == 0x85944171f73967e8ULL, "hash-3");
 	t.endGroup();
 
 	t.beginGroup("FSUtil");
@@ -96,6 +492,65 @@ int main(int, char* argv[])
 	t.result(FSUtil::getContents("this_file_exists.txt") == "These are the modified contents of this file.",
 		"getContents-3/putContents-3");
 
+	{
+		// A small buffer, so that it goes to the temporary file before committing.
+		FSUtil::AtomicWriter writer("this_file_exists.txt", 8);
+		writer << "These are " << "the streamed " << "contents.";
+		t.result(FSUtil::getContents("this_file_exists.txt") ==
+			"These are the modified contents of this file.", "AtomicWriter-1#uncommitted");
+		t.result(writer.commit() && FSUtil::getContents("this_file_exists.txt") ==
+			"These are the streamed contents." && !FSUtil::exists("this_file_exists.txt.tmp"),
+			"AtomicWriter-2");
+	}
+	{
+		FSUtil::AtomicWriter writer("this_file_exists.txt", 8);
+		writer << "Never committed.";
+	}
+	t.result(FSUtil::getContents("this_file_exists.txt") == "These are the streamed contents." &&
+		!FSUtil::exists("this_file_exists.txt.tmp"), "AtomicWriter-3#abandoned");
+	{
+		FSUtil::AtomicWriter writer("this_file_exists.txt", 8);
+		writer << "These are the streamed contents, and more.";
+		t.result(writer.commit() && FSUtil::getContents("this_file_exists.txt") ==
+			"These are the streamed contents, and more.", "AtomicWriter-4#longer");
+	}
+	{
+		FSUtil::AtomicWriter writer("this_file_exists.txt", 8);
+		writer << "These are the streamed contents";
+		t.result(writer.commit() && FSUtil::getContents("this_file_exists.txt") ==
+			"These are the streamed contents", "AtomicWriter-5#shorter");
+	}
+#ifndef _MSC_VER
+	{
+		// Writing what is already there must not so much as touch the file.
+		struct ::utimbuf old = {1000000000, 1000000000};
+		struct ::stat statbuf;
+		::utime("this_file_exists.txt", &old);
+		{
+			FSUtil::AtomicWriter writer("this_file_exists.txt", 8);
+			writer << "These are " << "the streamed " << "contents";
+			t.result(writer.commit() && !FSUtil::exists("this_file_exists.txt.tmp") &&
+				::stat("this_file_exists.txt", &statbuf) == 0 && statbuf.st_mtime == old.modtime,
+				"AtomicWriter-6#unchanged");
+		}
+		t.result(FSUtil::setContentsIfChanged("this_file_exists.txt", "These are the streamed contents") &&
+			::stat("this_file_exists.txt", &statbuf) == 0 && statbuf.st_mtime == old.modtime,
+			"setContentsIfChanged-1#unchanged");
+		t.result(FSUtil::setContentsIfChanged("this_file_exists.txt", "These are the streamed Contents") &&
+			::stat("this_file_exists.txt", &statbuf) == 0 && statbuf.st_mtime != old.modtime &&
+			FSUtil::getContents("this_file_exists.txt") == "These are the streamed Contents",
+			"setContentsIfChanged-2");
+	}
+#endif
+	{
+		FSUtil::AtomicWriter writer("this_file_exists.txt");
+		writer << "Finished, but not yet committed.";
+		t.result(writer.finish() && writer.changed() && FSUtil::getContents("this_file_exists.txt") ==
+			"These are the streamed Contents", "AtomicWriter-7#finish");
+		t.result(writer.commit() && FSUtil::getContents("this_file_exists.txt") ==
+			"Finished, but not yet committed.", "AtomicWriter-8#finish");
+	}
+
 	FSUtil::deleteFile("this_file_exists.txt");
 	t.result(!FSUtil::exists("this_file_exists.txt"), "deleteFile-1/exists-3");
 
@@ -112,10 +567,38 @@ int main(int, char* argv[])
 
 	const std::vector<std::string> files3 =
 		FSUtil::searchForFiles(FSUtil::combinePaths({dir, "../src/"}), {"Util.h"}, true);
-	t.result(files3.size() == 6, "searchForFiles-3");
+	t.result(files3.size() == 7, "searchForFiles-3");
+
+	const std::string src = FSUtil::combinePaths({dir, "../src"});
+	std::vector<std::string> directories;
+	FSUtil::searchForFiles(src, {".h"}, true, &directories);
+	t.result(directories.size() > 1 && directories[0] == src &&
+		std::find(directories.begin(), directories.end(),
+			FSUtil::combinePaths({src, "util"})) != directories.end(), "searchForFiles-4");
+
+	const unsigned int searchJobs = FSUtil::sSearchJobs;
+	FSUtil::sSearchJobs = 1;
+	FSUtil::clearDirectoryCache();
+	const std::vector<std::string> serial = FSUtil::searchForFiles(src, {".h", ".cpp"}, true);
+	FSUtil::sSearchJobs = 8;
+	FSUtil::clearDirectoryCache();
+	t.result(FSUtil::searchForFiles(src, {".h", ".cpp"}, true) == serial,
+		"searchForFiles-5#parallel");
+	FSUtil::sSearchJobs = searchJobs;
 
 	// We can't really do much here besides test that it actually finds something.
 	t.result(!FSUtil::which("find").empty(), "which-1");
+	{
+		// Looking again (even for something that isn't there) doesn't stat() anything.
+		const std::string missing = FSUtil::which("phoenix-no-such-program");
+		uint64_t queries, stats, queriesAfter, statsAfter;
+		FSUtil::metadataStatistics(queries, stats);
+		const bool same = FSUtil::which("phoenix-no-such-program") == missing &&
+			FSUtil::which("find") == FSUtil::which("find");
+		FSUtil::metadataStatistics(queriesAfter, statsAfter);
+		t.result(same && missing.empty() && queriesAfter == queries && statsAfter == stats,
+			"which-2#memoized");
+	}
 
 	t.result(FSUtil::normalizePath("/whatever/this//is//../././../whatever/dir2/dir9/apathto.txt") ==
 		"/whatever/whatever/dir2/dir9/apathto.txt", "normalizePath-1");
@@ -150,6 +633,103 @@ int main(int, char* argv[])
 	t.result(FSUtil::isDir("this_directory_now_exists"), "mkdir-1/isDir-5");
 	FSUtil::rmdir("this_directory_now_exists");
 	t.result(!FSUtil::isDir("this_directory_now_exists"), "rmdir-1/isDir-6");
+
+	std::string tempDir = FSUtil::mkdtemp("utiltest");
+	t.result(FSUtil::isDir(tempDir) && FSUtil::parentDirectory(tempDir) == FSUtil::tempDirectory(),
+		"mkdtemp-1");
+	std::string tempDir2 = FSUtil::mkdtemp("utiltest");
+	t.result(!tempDir2.empty() && tempDir2 != tempDir, "mkdtemp-2");
+	FSUtil::rmdir(tempDir2);
+	FSUtil::mkdir(FSUtil::combinePaths({tempDir, "subdir"}));
+	FSUtil::setContents(FSUtil::combinePaths({tempDir, "subdir", "file.txt"}), "contents");
+	FSUtil::rmdir(tempDir);
+	t.result(FSUtil::isDir(tempDir), "rmdir-2");
+	FSUtil::rmdir(tempDir, true);
+	t.result(!FSUtil::isDir(tempDir), "rmdir-3#recursive");
+
+	// Listings are cached, but entries being added must still be seen.
+	tempDir = FSUtil::mkdtemp("utiltest");
+	const std::string subdir = FSUtil::combinePaths({tempDir, "subdir"});
+	FSUtil::mkdir(subdir);
+	FSUtil::setContents(FSUtil::combinePaths({tempDir, "a.c"}), "");
+	FSUtil::setContents(FSUtil::combinePaths({subdir, "b.c"}), "");
+	FSUtil::setContents(FSUtil::combinePaths({subdir, "b.txt"}), "");
+	t.result(FSUtil::searchForFiles(tempDir, {".c"}, true).size() == 2, "searchForFiles-6");
+#ifndef _MSC_VER
+	{
+		// Directories modified within the last second aren't cached, so these
+		// are dated back; files added behind the cache's back (with the date
+		// put back afterwards) then show whether a listing came from it.
+		struct ::utimbuf old = {1000000000, 1000000000};
+		auto age = [&]() {
+			::utime(tempDir.c_str(), &old);
+			::utime(subdir.c_str(), &old);
+		};
+		age();
+		FSUtil::clearDirectoryCache();
+		std::vector<std::string> found = FSUtil::searchForFiles(tempDir, {".c"}, true);
+		FSUtil::setContents(FSUtil::combinePaths({subdir, "hidden.c"}), "");
+		age();
+		t.result(found.size() == 2 && FSUtil::searchForFiles(tempDir, {".c"}, true) == found,
+			"searchForFiles-7#cached");
+		FSUtil::setContents(FSUtil::combinePaths({subdir, "c.c"}), "");
+		found = FSUtil::searchForFiles(tempDir, {".c", ".h"}, true);
+		t.result(found.size() == 4, "searchForFiles-8#invalidated");
+
+		age();
+		FSUtil::searchForFiles(tempDir, {".c", ".h"}, true);
+		const std::string cacheFile = FSUtil::combinePaths({FSUtil::tempDirectory(),
+			"utiltest.dircache"});
+		const bool saved = FSUtil::saveDirectoryCache(cacheFile);
+		FSUtil::clearDirectoryCache();
+		FSUtil::setContents(FSUtil::combinePaths({subdir, "hidden2.c"}), "");
+		age();
+		t.result(saved && FSUtil::loadDirectoryCache(cacheFile) &&
+			FSUtil::searchForFiles(tempDir, {".c", ".h"}, true) == found, "directoryCache-1");
+		FSUtil::deleteFile(cacheFile);
+		FSUtil::clearDirectoryCache();
+	}
+#endif
+	FSUtil::rmdir(tempDir, true);
+
+	// Metadata is cached, but FSUtil's own changes must show.
+	tempDir = FSUtil::mkdtemp("utiltest");
+	const std::string metadataFile = FSUtil::combinePaths({tempDir, "file.txt"});
+	uint64_t queries, stats, queriesAfter, statsAfter;
+	t.result(!FSUtil::exists(metadataFile) && FSUtil::exists(tempDir), "exists-3");
+	FSUtil::setContents(metadataFile, "contents");
+	FSUtil::metadataStatistics(queries, stats);
+	t.result(FSUtil::isFile(metadataFile) && FSUtil::exists(metadataFile) &&
+		!FSUtil::isDir(metadataFile), "isFile-4#cached");
+	FSUtil::metadataStatistics(queriesAfter, statsAfter);
+	t.result(queriesAfter == queries + 3 && statsAfter == stats + 1, "metadataStatistics-1");
+	FSUtil::deleteFile(metadataFile);
+	t.result(!FSUtil::exists(metadataFile), "exists-4#deleted");
+	FSUtil::rmdir(tempDir, true);
+
+	std::vector<std::string> toAbsolutize = {"a/b.c", "./a//b.c", "../a/b.c", "/a/b.c", ""};
+	FSUtil::absolutePaths(toAbsolutize);
+	t.result(toAbsolutize[0] == FSUtil::absolutePath("a/b.c") && toAbsolutize[1] == toAbsolutize[0] &&
+		toAbsolutize[2] == FSUtil::absolutePath("../a/b.c") && toAbsolutize[3] == "/a/b.c" &&
+		toAbsolutize[4] == FSUtil::absolutePath("."), "absolutePaths-1");
+	const std::string cwd = FSUtil::absolutePath(".");
+	t.result(FSUtil::chdir("..") && FSUtil::absolutePath("a/b.c") ==
+			FSUtil::combinePaths({cwd, "../a/b.c"}) && FSUtil::chdir(cwd) &&
+		FSUtil::absolutePath("a/b.c") == toAbsolutize[0], "chdir-1");
+	t.endGroup();
+
+	t.beginGroup("Path");
+	const Path path("/whatever/this//is/../dir2/./apathto.txt");
+	t.result(path.str() == "/whatever/this/dir2/apathto.txt" && path.isAbsolute(), "Path-1");
+	t.result(path == Path("/whatever/this/dir2/apathto.txt") &&
+		path.parent() == Path("/whatever/this/dir2") && path.name() == "apathto.txt",
+		"Path-2#interned");
+	t.result(path.parent().join("../other/file.c").str() == "/whatever/this/other/file.c" &&
+		Path("shortpath").join(Path("../../data/")).str() == "../data", "Path-3#join");
+	t.result(!Path("relative/file.c").isAbsolute() &&
+		Path("relative/file.c").absolute() == Path(FSUtil::absolutePath("relative/file.c")) &&
+		Path("relative/file.c").absolute().isAbsolute() && path.absolute() == path,
+		"Path-4#absolute");
 	t.endGroup();
 
 	t.beginGroup("XmlUtil");
@@ -161,5 +741,25 @@ int main(int, char* argv[])
 		"ok=\"nop!e&quot;&lt;&gt;&amp;\"/>\n\t</hello_world>\n</test_tag>\n", "xmlgen-1");
 	t.endGroup();
 
+	t.beginGroup("TraceUtil");
+	TraceUtil::span("not-enabled", "test", 0);
+	t.result(TraceUtil::write() && !FSUtil::exists("this_trace_exists.json"), "disabled-1");
+	TraceUtil::enable("this_trace_exists.json");
+	{
+		TraceUtil::Span span("span \"quoted\"", "test", {{"arg", "value\n"}});
+	}
+	const int track = TraceUtil::acquireTrack();
+	t.result(track != TraceUtil::kMainTrack && TraceUtil::acquireTrack() != track, "acquireTrack-1");
+	TraceUtil::releaseTrack(track);
+	t.result(TraceUtil::acquireTrack() == track, "acquireTrack-2/releaseTrack-1");
+	t.result(TraceUtil::write(), "write-1");
+	const std::string trace = FSUtil::getContents("this_trace_exists.json");
+	t.result(StringUtil::startsWith(trace, "{\"traceEvents\": [") &&
+		trace.find("\"name\": \"span \\\"quoted\\\"\", \"cat\": \"test\", \"ph\": \"X\"") != std::string::npos &&
+		trace.find("\"args\": {\"arg\": \"value\\n\"}") != std::string::npos &&
+		trace.find("not-enabled") == std::string::npos, "write-2");
+	FSUtil::deleteFile("this_trace_exists.json");
+	t.endGroup();
+
 	return t.done();
 }